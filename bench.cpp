@@ -0,0 +1,482 @@
+/**
+@file bench.cpp
+@brief benchmark di SortedArray contro std::set, std::vector ordinato e flat_set
+
+Uso: bench.out [--max N] [--quad N] [--ops N] [--csv file] [--json file]
+
+  --max   dimensione massima (potenze di 10 da 1e3, default 1e6, fino a 1e8)
+  --quad  dimensione massima per le operazioni che costano O(n) per elemento,
+          cioe' la costruzione per inserimenti successivi (default 1e5)
+  --ops   numero di operazioni puntuali (find, searchsorted, remove) per misura
+  --csv   file CSV dei risultati (default bench_results.csv)
+  --json  file JSON dei risultati (default bench_results.json)
+
+Il default si ferma a 1e6 perche' con --max 1e8 i dati di tipo Person,
+le loro copie e i quattro contenitori occupano decine di GB e una
+esecuzione dura ore; 1e7 e 1e8 vanno chiesti esplicitamente.
+
+Le misure:
+  insert        inserimenti uno a uno nell'ordine dei dati (fino a --quad)
+  range_ctor    costruttore da una coppia di iteratori (fino a --quad)
+  sorted_build  dati ordinati una volta e aggiunti in coda, a ogni dimensione
+  copy          copia indipendente, che si puo' modificare senza toccare
+                l'originale (per SortedArray include lo sdoppiamento del
+                buffer condiviso)
+  remove        rimozione di chiavi casuali dalla copia
+
+Oltre --quad ogni contenitore viene costruito con sorted_build; le misure
+di insert e range_ctor oltre --quad non compaiono nei risultati.
+**/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include "sortedarray.h"
+
+// ---------------------------------------------------------------- tipi
+
+struct Person
+{
+  std::string name;
+  int age;
+  Person() : name(""), age(0){};
+  Person(const std::string &name, int age) : name(name), age(age){};
+};
+
+struct AgeOrderPolicy
+{
+  bool operator()(const Person &p1, const Person &p2) const
+  {
+    return p1.age < p2.age;
+  }
+};
+
+struct AgeEqualPolicy
+{
+  bool operator()(const Person &p1, const Person &p2) const
+  {
+    return p1.age == p2.age;
+  }
+};
+
+int key_of(const int &k) { return k; }
+int key_of(const Person &p) { return p.age; }
+
+int make(int k, const int *) { return k; }
+Person make(int k, const Person *) { return Person("person_" + std::to_string(k), k); }
+
+template <typename T>
+struct traits;
+
+template <>
+struct traits<int>
+{
+  typedef std::less<int> less;
+  typedef std::equal_to<int> equal;
+  static const char *name() { return "int"; }
+};
+
+template <>
+struct traits<Person>
+{
+  typedef AgeOrderPolicy less;
+  typedef AgeEqualPolicy equal;
+  static const char *name() { return "Person"; }
+};
+
+// circa meta' delle chiavi (che sono tutte pari) supera il filtro
+template <typename T>
+bool selected(const T &v)
+{
+  return (key_of(v) / 2) % 2 == 0;
+}
+
+// ---------------------------------------------------------------- adattatori
+
+template <typename T>
+struct SortedArrayBench
+{
+  typedef SortedArray<T, typename traits<T>::less, typename traits<T>::equal> container;
+  typedef typename traits<T>::less less;
+  static const char *name() { return "SortedArray"; }
+
+  container c;
+
+  void insert(const T &v) { c.insert(v); }
+  bool find(const T &v) const { return c.find(v); }
+  const T *lower(const T &v) const
+  {
+    std::size_t index = c.searchsorted(v);
+    return index < c.size() ? c.data() + index : nullptr;
+  }
+  void remove(const T &v) { c.remove(v); }
+  std::size_t filter() const { return c.filter(selected<T>).size(); }
+  std::size_t size() const { return c.size(); }
+  // la copia condivide il buffer: riservare spazio ne fa una copia privata
+  void own() { c.reserve(c.capacity() + 1); }
+  template <typename Iter>
+  void assign(Iter first, Iter last)
+  {
+    container tmp(first, last);
+    c.swap(tmp);
+  }
+  // dati ordinati una volta e aggiunti in coda, O(n log n)
+  template <typename Iter>
+  void build_sorted(Iter first, Iter last)
+  {
+    std::vector<T> sorted(first, last);
+    std::stable_sort(sorted.begin(), sorted.end(), less());
+    container tmp;
+    tmp.reserve(sorted.size());
+    for (std::size_t i = 0; i < sorted.size(); ++i)
+      tmp.insert(tmp.end(), sorted[i]);
+    c.swap(tmp);
+  }
+};
+
+template <typename T>
+struct SetBench
+{
+  typedef std::set<T, typename traits<T>::less> container;
+  static const char *name() { return "std::set"; }
+
+  container c;
+
+  void insert(const T &v) { c.insert(v); }
+  bool find(const T &v) const { return c.find(v) != c.end(); }
+  const T *lower(const T &v) const
+  {
+    typename container::const_iterator it = c.lower_bound(v);
+    return it != c.end() ? &*it : nullptr;
+  }
+  void remove(const T &v) { c.erase(v); }
+  std::size_t filter() const
+  {
+    container out;
+    for (typename container::const_iterator it = c.begin(); it != c.end(); ++it)
+      if (selected(*it))
+        out.insert(out.end(), *it);
+    return out.size();
+  }
+  std::size_t size() const { return c.size(); }
+  void own() {}
+  template <typename Iter>
+  void assign(Iter first, Iter last)
+  {
+    container tmp(first, last);
+    c.swap(tmp);
+  }
+  template <typename Iter>
+  void build_sorted(Iter first, Iter last)
+  {
+    std::vector<T> sorted(first, last);
+    std::stable_sort(sorted.begin(), sorted.end(), typename traits<T>::less());
+    container tmp;
+    for (std::size_t i = 0; i < sorted.size(); ++i)
+      tmp.insert(tmp.end(), sorted[i]);
+    c.swap(tmp);
+  }
+};
+
+template <typename T>
+struct VectorBench
+{
+  typedef std::vector<T> container;
+  typedef typename traits<T>::less less;
+  static const char *name() { return "sorted std::vector"; }
+
+  container c;
+
+  void insert(const T &v)
+  {
+    c.insert(std::upper_bound(c.begin(), c.end(), v, less()), v);
+  }
+  bool find(const T &v) const
+  {
+    typename container::const_iterator it = std::lower_bound(c.begin(), c.end(), v, less());
+    return it != c.end() && !less()(v, *it);
+  }
+  const T *lower(const T &v) const
+  {
+    typename container::const_iterator it = std::lower_bound(c.begin(), c.end(), v, less());
+    return it != c.end() ? &*it : nullptr;
+  }
+  void remove(const T &v)
+  {
+    typename container::iterator it = std::lower_bound(c.begin(), c.end(), v, less());
+    if (it != c.end() && !less()(v, *it))
+      c.erase(it);
+  }
+  std::size_t filter() const
+  {
+    container out;
+    for (std::size_t i = 0; i < c.size(); ++i)
+      if (selected(c[i]))
+        out.push_back(c[i]);
+    return out.size();
+  }
+  std::size_t size() const { return c.size(); }
+  void own() {}
+  template <typename Iter>
+  void assign(Iter first, Iter last)
+  {
+    container tmp(first, last);
+    std::stable_sort(tmp.begin(), tmp.end(), less());
+    c.swap(tmp);
+  }
+  // il vettore si ordina direttamente, senza una copia a parte
+  template <typename Iter>
+  void build_sorted(Iter first, Iter last)
+  {
+    assign(first, last);
+  }
+};
+
+// std::flat_set arriva solo con C++23: stessa idea, vettore ordinato a
+// chiavi uniche con inserimento che scarta i duplicati
+template <typename T>
+struct FlatSetBench : VectorBench<T>
+{
+  typedef typename VectorBench<T>::less less;
+  static const char *name() { return "flat_set"; }
+
+  void insert(const T &v)
+  {
+    typename std::vector<T>::iterator it =
+        std::lower_bound(this->c.begin(), this->c.end(), v, less());
+    if (it == this->c.end() || less()(v, *it))
+      this->c.insert(it, v);
+  }
+  template <typename Iter>
+  void assign(Iter first, Iter last)
+  {
+    build_sorted(first, last);
+  }
+  template <typename Iter>
+  void build_sorted(Iter first, Iter last)
+  {
+    VectorBench<T>::assign(first, last);
+    this->c.erase(std::unique(this->c.begin(), this->c.end(),
+                              [](const T &a, const T &b)
+                              { return !less()(a, b) && !less()(b, a); }),
+                  this->c.end());
+  }
+};
+
+// ---------------------------------------------------------------- misure
+
+struct Result
+{
+  std::string container, type, order, op;
+  std::size_t n, count;
+  double ns;
+};
+
+struct Options
+{
+  std::size_t max_n = 1000000;
+  std::size_t quad_n = 100000;
+  std::size_t ops = 10000;
+  std::string csv = "bench_results.csv";
+  std::string json = "bench_results.json";
+};
+
+static std::vector<Result> results;
+static volatile std::size_t sink; // evita che il compilatore elimini il lavoro
+
+typedef std::chrono::steady_clock clock_type;
+
+double elapsed_ns(clock_type::time_point start)
+{
+  return std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+}
+
+void record(const char *container, const char *type, const char *order,
+            const char *op, std::size_t n, std::size_t count, double ns)
+{
+  Result r = {container, type, order, op, n, count, ns};
+  results.push_back(r);
+  std::cout << container << '\t' << type << '\t' << order << '\t' << n << '\t'
+            << op << '\t' << (count ? ns / count : 0) << " ns/op" << std::endl;
+}
+
+// chiavi distinte e pari, cosi' le chiavi dispari sono sempre assenti
+std::vector<int> make_keys(std::size_t n, const std::string &order, std::mt19937 &rng)
+{
+  std::vector<int> keys(n);
+  for (std::size_t i = 0; i < n; ++i)
+    keys[i] = static_cast<int>(2 * i);
+  if (order == "random")
+    std::shuffle(keys.begin(), keys.end(), rng);
+  else if (order == "adversarial")
+    std::reverse(keys.begin(), keys.end()); // ogni inserimento finisce in testa
+  return keys;
+}
+
+template <typename B, typename T>
+void run(const std::vector<T> &data, const char *order, const Options &opt, std::mt19937 &rng)
+{
+  const std::size_t n = data.size();
+  const char *type = traits<T>::name();
+  const bool quadratic_ok = n <= opt.quad_n;
+  clock_type::time_point start;
+
+  B b;
+  if (quadratic_ok)
+  {
+    start = clock_type::now();
+    for (std::size_t i = 0; i < n; ++i)
+      b.insert(data[i]);
+    record(B::name(), type, order, "insert", n, n, elapsed_ns(start));
+
+    start = clock_type::now();
+    B r;
+    r.assign(data.begin(), data.end());
+    sink = r.size();
+    record(B::name(), type, order, "range_ctor", n, n, elapsed_ns(start));
+  }
+
+  start = clock_type::now();
+  B s;
+  s.build_sorted(data.begin(), data.end());
+  sink = s.size();
+  record(B::name(), type, order, "sorted_build", n, n, elapsed_ns(start));
+  if (!quadratic_ok)
+    std::swap(b, s); // inserimenti uno a uno troppo costosi
+
+  std::vector<T> probes;
+  std::uniform_int_distribution<int> dist(0, static_cast<int>(2 * n));
+  for (std::size_t i = 0; i < std::min(n, opt.ops); ++i)
+    probes.push_back(make(dist(rng), static_cast<const T *>(nullptr)));
+
+  std::size_t hits = 0;
+  start = clock_type::now();
+  for (std::size_t i = 0; i < probes.size(); ++i)
+    hits += b.find(probes[i]);
+  sink = hits;
+  record(B::name(), type, order, "find", n, probes.size(), elapsed_ns(start));
+
+  // ogni contenitore restituisce la posizione trovata, letta per non
+  // lasciare al compilatore solo il confronto con la fine
+  std::size_t acc = 0;
+  start = clock_type::now();
+  for (std::size_t i = 0; i < probes.size(); ++i)
+  {
+    const T *pos = b.lower(probes[i]);
+    if (pos != nullptr)
+      acc += key_of(*pos);
+  }
+  sink = acc;
+  record(B::name(), type, order, "searchsorted", n, probes.size(), elapsed_ns(start));
+
+  start = clock_type::now();
+  sink = b.filter();
+  record(B::name(), type, order, "filter", n, n, elapsed_ns(start));
+
+  start = clock_type::now();
+  B copy(b);
+  copy.own();
+  sink = copy.size();
+  record(B::name(), type, order, "copy", n, n, elapsed_ns(start));
+
+  // remove costa O(n) per elemento nelle strutture ad array; le chiavi
+  // casuali evitano di togliere sempre la testa, che SortedArray toglie
+  // in O(1) e std::vector in O(n)
+  std::size_t removals = quadratic_ok ? probes.size() : std::min<std::size_t>(probes.size(), 100);
+  start = clock_type::now();
+  for (std::size_t i = 0; i < removals; ++i)
+    copy.remove(probes[i]);
+  sink = copy.size();
+  record(B::name(), type, order, "remove", n, removals, elapsed_ns(start));
+}
+
+template <typename T>
+void run_type(const Options &opt)
+{
+  static const char *orders[] = {"random", "sorted", "adversarial"};
+  std::mt19937 rng(42);
+
+  for (std::size_t n = 1000; n <= opt.max_n; n *= 10)
+  {
+    for (int o = 0; o < 3; ++o)
+    {
+      std::vector<int> keys = make_keys(n, orders[o], rng);
+      std::vector<T> data;
+      data.reserve(n);
+      for (std::size_t i = 0; i < n; ++i)
+        data.push_back(make(keys[i], static_cast<const T *>(nullptr)));
+
+      run<SortedArrayBench<T>>(data, orders[o], opt, rng);
+      run<SetBench<T>>(data, orders[o], opt, rng);
+      run<VectorBench<T>>(data, orders[o], opt, rng);
+      run<FlatSetBench<T>>(data, orders[o], opt, rng);
+    }
+  }
+}
+
+void write_csv(const std::string &file)
+{
+  std::ofstream out(file.c_str());
+  out << "container,type,order,n,op,count,total_ns,ns_per_op\n";
+  for (std::size_t i = 0; i < results.size(); ++i)
+  {
+    const Result &r = results[i];
+    out << '"' << r.container << "\"," << r.type << ',' << r.order << ',' << r.n << ','
+        << r.op << ',' << r.count << ',' << r.ns << ',' << (r.count ? r.ns / r.count : 0) << '\n';
+  }
+}
+
+void write_json(const std::string &file)
+{
+  std::ofstream out(file.c_str());
+  out << "[\n";
+  for (std::size_t i = 0; i < results.size(); ++i)
+  {
+    const Result &r = results[i];
+    out << "  {\"container\": \"" << r.container << "\", \"type\": \"" << r.type
+        << "\", \"order\": \"" << r.order << "\", \"n\": " << r.n
+        << ", \"op\": \"" << r.op << "\", \"count\": " << r.count
+        << ", \"total_ns\": " << r.ns
+        << ", \"ns_per_op\": " << (r.count ? r.ns / r.count : 0) << '}'
+        << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  out << "]\n";
+}
+
+int main(int argc, char const *argv[])
+{
+  Options opt;
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    std::string arg = argv[i];
+    if (arg == "--max")
+      opt.max_n = static_cast<std::size_t>(std::strtod(argv[i + 1], nullptr));
+    else if (arg == "--quad")
+      opt.quad_n = static_cast<std::size_t>(std::strtod(argv[i + 1], nullptr));
+    else if (arg == "--ops")
+      opt.ops = static_cast<std::size_t>(std::strtod(argv[i + 1], nullptr));
+    else if (arg == "--csv")
+      opt.csv = argv[i + 1];
+    else if (arg == "--json")
+      opt.json = argv[i + 1];
+    else
+    {
+      std::cerr << "opzione sconosciuta: " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  run_type<int>(opt);
+  run_type<Person>(opt);
+
+  write_csv(opt.csv);
+  write_json(opt.json);
+  std::cout << "risultati in " << opt.csv << " e " << opt.json << std::endl;
+  return 0;
+}
@@ -0,0 +1,515 @@
+#ifndef ExternalSortedArray_H
+#define ExternalSortedArray_H
+
+#include <cassert>     // assert
+#include <cstddef>     // std::size_t
+#include <cstdio>      // std::remove
+#include <fstream>     // std::ifstream, std::ofstream
+#include <string>      // std::string
+#include <algorithm>   // std::sort, std::min
+#include <queue>       // std::priority_queue
+#include <vector>      // std::vector
+#include <stdexcept>   // std::runtime_error
+#include <type_traits> // std::is_trivially_copyable
+#include <mutex>       // std::mutex, std::lock_guard
+
+/**
+  @file externalsortedarray.h
+  @brief Dichiarazione della classe ExternalSortedArray
+*/
+
+/**
+  @brief Classe ExternalSortedArray
+
+  Array ordinato su disco, per dataset piu' grandi della RAM.
+
+  La costruzione da una sequenza non ordinata usa un merge sort esterno:
+  la sequenza viene letta a pezzi di run_elements elementi, ogni pezzo
+  viene ordinato in memoria e scritto in un file temporaneo (run), poi le
+  run vengono fuse in un unico file ordinato con un merge a k vie. Si
+  tengono aperte al massimo fan_in run alla volta: se ce ne sono di piu'
+  le passate intermedie le fondono a gruppi in run piu' lunghe.
+
+  Ogni apertura, lettura e scrittura viene controllata: in caso di errore
+  il costruttore lancia std::runtime_error dopo aver cancellato le run e
+  il file ordinato parziale.
+
+  In memoria resta solo un indice sparso (fence index): la prima chiave di
+  ogni blocco di block_elements elementi. lower_bound e find cercano il
+  blocco tra le fence e poi leggono un solo blocco dal file. L'ultimo
+  blocco letto resta in cache, quindi accessi vicini non rileggono il disco.
+
+  I metodi const si possono chiamare da piu' thread (ad esempio da
+  merge_join con threads > 1): file e cache sono condivisi e protetti da
+  un mutex, quindi le letture di blocco vengono eseguite una alla volta.
+
+  Tutte le posizioni sono a 64 bit: il limite e' lo spazio su disco.
+
+  Lista parametri template:
+  @param T Tipo dei dati, deve essere trivially copyable (viene scritto
+           byte per byte sul file)
+  @param P Policy per il confronto e ordinamento degli elementi
+*/
+template <typename T, typename P>
+class ExternalSortedArray
+{
+  static_assert(std::is_trivially_copyable<T>::value,
+                "ExternalSortedArray richiede un tipo trivially copyable");
+
+public:
+  typedef T value_type;          /// Tipo del dato dell'array
+  typedef std::size_t size_type; /// Tipo del dato size, a 64 bit
+  typedef P order_policy;
+
+  /**
+    @brief Costruttore da iteratori, con merge sort esterno
+
+    @param path file in cui scrivere l'array ordinato
+    @param begin iteratore di inizio seq (non ordinata)
+    @param end iteratore di fine seq
+    @param run_elements elementi ordinati in memoria per ogni run
+    @param block_elements elementi per blocco del file ordinato
+    @param fan_in massimo numero di run aperte insieme durante il merge,
+           almeno 2
+
+    @post size() = diff(end, begin)
+  */
+  template <typename Iter>
+  ExternalSortedArray(const std::string &path, Iter begin, Iter end,
+                      size_type run_elements = size_type(1) << 20,
+                      size_type block_elements = 4096,
+                      size_type fan_in = 64)
+      : _path(path), _size(0), _block(block_elements), _fences(nullptr), _blocks(0),
+        _cache(nullptr), _cached(npos), _reads(0)
+  {
+    if (run_elements == 0 || block_elements == 0)
+      throw std::invalid_argument("ExternalSortedArray: dimensioni nulle");
+    if (fan_in < 2)
+      throw std::invalid_argument("ExternalSortedArray: fan_in minore di 2");
+
+    std::vector<std::string> runs;
+    try
+    {
+      write_runs(begin, end, run_elements, runs);
+      merge_runs(runs, fan_in);
+      for (size_type r = 0; r < runs.size(); ++r)
+        std::remove(runs[r].c_str());
+      runs.clear();
+      open_file();
+    }
+    catch (...)
+    {
+      for (size_type r = 0; r < runs.size(); ++r)
+        std::remove(runs[r].c_str());
+      delete[] _fences;
+      delete[] _cache;
+      throw;
+    }
+  }
+
+  /**
+    @brief Costruttore da un file gia' ordinato
+
+    Ricostruisce l'indice sparso leggendo la prima chiave di ogni blocco.
+
+    @param path file ordinato (ad esempio scritto da un'altra istanza)
+    @param block_elements elementi per blocco
+  */
+  explicit ExternalSortedArray(const std::string &path, size_type block_elements = 4096)
+      : _path(path), _size(0), _block(block_elements), _fences(nullptr), _blocks(0),
+        _cache(nullptr), _cached(npos), _reads(0)
+  {
+    if (block_elements == 0)
+      throw std::invalid_argument("ExternalSortedArray: dimensioni nulle");
+
+    try
+    {
+      open_file();
+      _file.seekg(0, std::ios::end);
+      _size = static_cast<size_type>(_file.tellg()) / sizeof(value_type);
+      _blocks = (_size + _block - 1) / _block;
+      _fences = new value_type[_blocks];
+      for (size_type b = 0; b < _blocks; ++b)
+      {
+        _file.seekg(static_cast<std::streamoff>(b * _block * sizeof(value_type)));
+        _file.read(reinterpret_cast<char *>(&_fences[b]), sizeof(value_type));
+      }
+      if (!_file)
+        throw std::runtime_error("ExternalSortedArray: lettura fallita di " + _path);
+    }
+    catch (...)
+    {
+      delete[] _fences;
+      delete[] _cache;
+      throw;
+    }
+  }
+
+  ExternalSortedArray(const ExternalSortedArray &other) = delete;
+  ExternalSortedArray &operator=(const ExternalSortedArray &other) = delete;
+
+  /**
+    @brief Distruttore
+
+    Libera indice e cache; il file ordinato resta su disco.
+  */
+  ~ExternalSortedArray()
+  {
+    delete[] _fences;
+    delete[] _cache;
+  }
+
+  /**
+    @brief Numero di elementi
+
+    @return dimensione dell'array
+  */
+  size_type size() const
+  {
+    return _size;
+  }
+
+  /**
+    @brief Posizione del primo elemento non minore di key
+
+    Ricerca binaria tra le fence in memoria, poi al massimo una lettura
+    di blocco.
+
+    @param key chiave da cercare
+
+    @return posizione in [0, size()]
+  */
+  size_type lower_bound(const value_type &key) const
+  {
+    order_policy ord;
+    size_type b = first_fence_not_less(key);
+    if (b == 0)
+      return 0;
+
+    // la risposta sta nel blocco b - 1, oppure e' l'inizio del blocco b
+    std::lock_guard<std::mutex> lock(_lock);
+    const value_type *block = load(b - 1);
+    size_type len = block_length(b - 1);
+    size_type under = 0;
+    size_type upper = len;
+    while (under < upper)
+    {
+      size_type mid = under + (upper - under) / 2;
+      if (ord(block[mid], key))
+        under = mid + 1;
+      else
+        upper = mid;
+    }
+    return (b - 1) * _block + under;
+  }
+
+  /**
+    @brief Verifica se un elemento equivalente a key e' presente
+
+    @param key chiave da cercare
+
+    @return true se presente
+  */
+  bool find(const value_type &key) const
+  {
+    order_policy ord;
+    size_type pos = lower_bound(key);
+    if (pos == _size)
+      return false;
+    return !ord(key, (*this)[pos]);
+  }
+
+  /**
+    @brief Lettura dell'elemento index-esimo
+
+    @param index posizione da leggere
+
+    @return copia dell'elemento
+
+    @pre index < size()
+  */
+  value_type operator[](size_type index) const
+  {
+    assert(index < _size);
+    if (index % _block == 0)
+      return _fences[index / _block];
+    std::lock_guard<std::mutex> lock(_lock);
+    return load(index / _block)[index % _block];
+  }
+
+  /**
+    @brief Numero di blocchi letti dal file
+
+    @return letture di blocco eseguite
+  */
+  size_type block_reads() const
+  {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _reads;
+  }
+
+  /**
+    @brief Memoria occupata dall'indice sparso
+
+    @return dimensione in byte delle fence
+  */
+  size_type fence_bytes() const
+  {
+    return _blocks * sizeof(value_type);
+  }
+
+private:
+  // indice non valido, usato come "nessun blocco in cache"
+  static const size_type npos = static_cast<size_type>(-1);
+
+  // un file temporaneo ordinato, letto un blocco alla volta durante il merge
+  struct run_reader
+  {
+    std::string name;
+    std::ifstream in;
+    value_type *buffer;
+    size_type length;
+    size_type pos;
+
+    run_reader() : buffer(nullptr), length(0), pos(0)
+    {
+    }
+
+    ~run_reader()
+    {
+      delete[] buffer;
+    }
+
+    // legge il blocco successivo; false a fine file
+    bool refill(size_type capacity)
+    {
+      in.read(reinterpret_cast<char *>(buffer), capacity * sizeof(value_type));
+      std::streamsize got = in.gcount();
+      if (in.bad() || (!in && !in.eof()) || got % sizeof(value_type) != 0)
+        throw std::runtime_error("ExternalSortedArray: lettura fallita di " + name);
+      length = static_cast<size_type>(got) / sizeof(value_type);
+      pos = 0;
+      return length > 0;
+    }
+  };
+
+  template <typename Iter>
+  void write_runs(Iter begin, Iter end, size_type run_elements, std::vector<std::string> &runs)
+  {
+    order_policy ord;
+    value_type *buffer = new value_type[run_elements];
+    try
+    {
+      while (begin != end)
+      {
+        size_type n = 0;
+        for (; n < run_elements && begin != end; ++begin, ++n)
+          buffer[n] = static_cast<value_type>(*begin);
+        std::sort(buffer, buffer + n, ord);
+
+        runs.push_back(_path + ".run" + std::to_string(runs.size()));
+        std::ofstream out(runs.back().c_str(), std::ios::binary | std::ios::trunc);
+        if (!out)
+          throw std::runtime_error("ExternalSortedArray: impossibile aprire " + runs.back());
+        out.write(reinterpret_cast<const char *>(buffer), n * sizeof(value_type));
+        out.close();
+        if (!out)
+          throw std::runtime_error("ExternalSortedArray: scrittura fallita di " + runs.back());
+        _size += n;
+      }
+    }
+    catch (...)
+    {
+      delete[] buffer;
+      throw;
+    }
+    delete[] buffer;
+  }
+
+  // heap di indici di run, in cima quella con l'elemento corrente minore
+  struct head_greater
+  {
+    const std::vector<run_reader *> *readers;
+
+    bool operator()(size_type a, size_type b) const
+    {
+      order_policy ord;
+      const run_reader &ra = *(*readers)[a];
+      const run_reader &rb = *(*readers)[b];
+      return ord(rb.buffer[rb.pos], ra.buffer[ra.pos]);
+    }
+  };
+
+  /*
+    Fonde le run nel file _path. Finche' le run sono piu' di fan_in, ogni
+    passata le fonde a gruppi di fan_in in nuove run (cancellando quelle
+    consumate); l'ultima passata scrive il file ordinato e le fence.
+  */
+  void merge_runs(std::vector<std::string> &runs, size_type fan_in)
+  {
+    size_type first = 0;
+    while (runs.size() - first > fan_in)
+    {
+      size_type last = runs.size();
+      for (size_type r = first; r < last; r += fan_in)
+      {
+        size_type to = std::min(r + fan_in, last);
+        std::string output = _path + ".run" + std::to_string(runs.size());
+        runs.push_back(output);
+        merge_group(runs, r, to, output, false);
+        for (size_type i = r; i < to; ++i)
+          std::remove(runs[i].c_str());
+      }
+      first = last;
+    }
+
+    _blocks = (_size + _block - 1) / _block;
+    _fences = new value_type[_blocks];
+    merge_group(runs, first, runs.size(), _path, true);
+  }
+
+  /*
+    Merge a k vie di runs[first, last) nel file output; con fences riempie
+    anche l'indice sparso. Se qualcosa fallisce il file output parziale
+    viene cancellato prima di rilanciare.
+  */
+  void merge_group(const std::vector<std::string> &runs, size_type first, size_type last,
+                   const std::string &output, bool fences)
+  {
+    std::vector<run_reader *> readers;
+    value_type *out_buffer = nullptr;
+    std::ofstream out;
+    bool created = false;
+    try
+    {
+      for (size_type r = first; r < last; ++r)
+      {
+        readers.push_back(new run_reader());
+        readers.back()->name = runs[r];
+        readers.back()->buffer = new value_type[_block];
+        readers.back()->in.open(runs[r].c_str(), std::ios::binary);
+        if (!readers.back()->in)
+          throw std::runtime_error("ExternalSortedArray: impossibile aprire " + runs[r]);
+      }
+
+      head_greater cmp;
+      cmp.readers = &readers;
+      std::priority_queue<size_type, std::vector<size_type>, head_greater> heap(cmp);
+      for (size_type r = 0; r < readers.size(); ++r)
+        if (readers[r]->refill(_block))
+          heap.push(r);
+
+      out.open(output.c_str(), std::ios::binary | std::ios::trunc);
+      if (!out)
+        throw std::runtime_error("ExternalSortedArray: impossibile aprire " + output);
+      created = true;
+
+      out_buffer = new value_type[_block];
+      size_type written = 0;
+      size_type filled = 0;
+      while (!heap.empty())
+      {
+        size_type r = heap.top();
+        heap.pop();
+        run_reader &reader = *readers[r];
+
+        if (fences && written % _block == 0)
+          _fences[written / _block] = reader.buffer[reader.pos];
+        out_buffer[filled++] = reader.buffer[reader.pos];
+        ++written;
+        if (filled == _block)
+        {
+          out.write(reinterpret_cast<const char *>(out_buffer), filled * sizeof(value_type));
+          if (!out)
+            throw std::runtime_error("ExternalSortedArray: scrittura fallita di " + output);
+          filled = 0;
+        }
+
+        if (++reader.pos < reader.length || reader.refill(_block))
+          heap.push(r);
+      }
+      out.write(reinterpret_cast<const char *>(out_buffer), filled * sizeof(value_type));
+      out.close();
+      if (!out || (fences && written != _size))
+        throw std::runtime_error("ExternalSortedArray: scrittura fallita di " + output);
+    }
+    catch (...)
+    {
+      if (created)
+      {
+        out.close();
+        std::remove(output.c_str());
+      }
+      delete[] out_buffer;
+      for (size_type r = 0; r < readers.size(); ++r)
+        delete readers[r];
+      throw;
+    }
+    delete[] out_buffer;
+    for (size_type r = 0; r < readers.size(); ++r)
+      delete readers[r];
+  }
+
+  void open_file()
+  {
+    _file.open(_path.c_str(), std::ios::binary);
+    if (!_file)
+      throw std::runtime_error("ExternalSortedArray: impossibile aprire " + _path);
+    _cache = new value_type[_block];
+  }
+
+  // primo blocco la cui prima chiave non e' minore di key (_blocks se nessuno)
+  size_type first_fence_not_less(const value_type &key) const
+  {
+    order_policy ord;
+    size_type under = 0;
+    size_type upper = _blocks;
+    while (under < upper)
+    {
+      size_type mid = under + (upper - under) / 2;
+      if (ord(_fences[mid], key))
+        under = mid + 1;
+      else
+        upper = mid;
+    }
+    return under;
+  }
+
+  size_type block_length(size_type b) const
+  {
+    return (b + 1 < _blocks) ? _block : _size - b * _block;
+  }
+
+  // porta il blocco b nella cache, leggendolo dal file se serve; il
+  // chiamante tiene _lock finche' usa il blocco
+  const value_type *load(size_type b) const
+  {
+    if (_cached != b)
+    {
+      _file.clear();
+      _file.seekg(static_cast<std::streamoff>(b * _block * sizeof(value_type)));
+      _file.read(reinterpret_cast<char *>(_cache), block_length(b) * sizeof(value_type));
+      if (!_file)
+      {
+        _cached = npos;
+        throw std::runtime_error("ExternalSortedArray: lettura fallita di " + _path);
+      }
+      _cached = b;
+      ++_reads;
+    }
+    return _cache;
+  }
+
+  std::string _path;
+  size_type _size;
+  size_type _block;          // elementi per blocco
+  value_type *_fences;       // prima chiave di ogni blocco
+  size_type _blocks;         // numero di blocchi
+  mutable std::ifstream _file;
+  mutable value_type *_cache; // ultimo blocco letto
+  mutable size_type _cached;  // indice del blocco in cache
+  mutable size_type _reads;   // blocchi letti dal file
+  mutable std::mutex _lock;   // protegge _file, _cache, _cached e _reads
+};
+
+#endif
@@ -0,0 +1,771 @@
+#ifndef KeyedSortedArray_H
+#define KeyedSortedArray_H
+
+#include <cassert>
+#include <iterator>    // std::random_access_iterator_tag
+#include <cstddef>     // std::ptrdiff_t, std::size_t
+#include <type_traits> // std::decay, std::is_nothrow_move_assignable
+#include <utility>     // std::swap, std::declval, std::move
+
+/**
+  @file keyedsortedarray.h
+  @brief Dichiarazione della classe KeyedSortedArray
+*/
+
+/**
+  @brief Classe KeyedSortedArray
+
+  Array dinamico ordinato per chiave, memorizzato come structure of arrays:
+  le chiavi estratte dai record stanno in un array denso (_keys) e i record
+  completi in un array parallelo (_values). Ricerche, filtri per chiave e
+  query su intervalli leggono solo la colonna delle chiavi; il record viene
+  letto solo quando si dereferenzia un iteratore o si usa operator[].
+
+  Le due colonne hanno la stessa capacita', che raddoppia quando e'
+  piena: insert e remove spostano i record in place, senza riallocare
+  (per tipi con move nothrow; altrimenti copiano in colonne nuove).
+
+  Lista parametri template:
+  @param T Tipo dei record da inserire nel container
+  @param K Estrattore della chiave: funtore con key_type operator()(const T&)
+  @param P Policy per il confronto e ordinamento delle chiavi
+  @param Q Policy di uguaglianza sui record, usata da find e remove
+*/
+template <typename T, typename K, typename P, typename Q>
+class KeyedSortedArray
+{
+public:
+  typedef T value_type;           /// Tipo dei record
+  typedef std::size_t size_type;  /// Tipo del dato size, a 64 bit
+  typedef K key_extractor;
+  typedef typename std::decay<decltype(std::declval<K>()(std::declval<const T &>()))>::type
+      key_type;                   /// Tipo della chiave
+  typedef P order_policy;
+  typedef Q equal_policy;
+
+  /**
+    @brief Costruttore di default
+
+    @post size() = 0
+  */
+  KeyedSortedArray() : _keys(nullptr), _values(nullptr), _size(0), _capacity(0)
+  {
+  }
+
+  /**
+    @brief Distruttore
+
+    Si rimanda a @ref makeEmpty()
+  */
+  ~KeyedSortedArray()
+  {
+    this->makeEmpty();
+  }
+
+  /**
+    @brief Copy Constructor
+
+    @param other KeyedSortedArray sorgente da copiare
+
+    @post size() = other.size()
+  */
+  KeyedSortedArray(const KeyedSortedArray &other)
+      : _keys(nullptr), _values(nullptr), _size(0), _capacity(0)
+  {
+    if (other._size == 0)
+      return;
+
+    try
+    {
+      _keys = new key_type[other._size];
+      _values = new value_type[other._size];
+      for (size_type i = 0; i < other._size; ++i)
+      {
+        _keys[i] = other._keys[i];
+        _values[i] = other._values[i];
+      }
+    }
+    catch (...)
+    {
+      makeEmpty();
+      throw;
+    }
+    _size = other._size;
+    _capacity = other._size;
+  }
+
+  /**
+    @brief Costruttore da iteratori
+
+    @param begin Iter di inizio seq
+    @param end iteratore di fine seq
+
+    @post size() = diff(end, begin)
+  */
+  template <typename Iter>
+  KeyedSortedArray(Iter begin, Iter end)
+      : _keys(nullptr), _values(nullptr), _size(0), _capacity(0)
+  {
+    try
+    {
+      for (; begin != end; ++begin)
+        this->insert(static_cast<value_type>(*begin));
+    }
+    catch (...)
+    {
+      makeEmpty();
+      throw;
+    }
+  }
+
+  /**
+    @brief Operatore di assegnamento
+
+    @param other KeyedSortedArray sorgente da copiare
+
+    @return reference all'oggetto corrente
+  */
+  KeyedSortedArray &operator=(const KeyedSortedArray &other)
+  {
+    if (this != &other)
+    {
+      KeyedSortedArray tmp(other);
+      this->swap(tmp);
+    }
+    return *this;
+  }
+
+  /**
+    @brief Inserimento di un record
+
+    La chiave viene estratta una volta sola e salvata nella colonna delle
+    chiavi.
+
+    @param item record da inserire
+
+    @return true, l'inserimento non viene mai rifiutato
+
+    @post size()++
+  */
+  bool insert(const value_type &item)
+  {
+    key_extractor key_of;
+    key_type key = key_of(item);
+    size_type index = searchsorted(key);
+
+    if (_size < _capacity && in_place)
+    {
+      // copia preventiva: item potrebbe essere un record dell'array
+      value_type copy(item);
+      for (size_type i = _size; i > index; --i)
+      {
+        _keys[i] = std::move(_keys[i - 1]);
+        _values[i] = std::move(_values[i - 1]);
+      }
+      _keys[index] = std::move(key);
+      _values[index] = std::move(copy);
+      ++_size;
+      return true;
+    }
+
+    // con spazio libero (move che puo' lanciare) la capacita' non cambia
+    size_type capacity = (_size < _capacity) ? _capacity
+                         : (_size < 4)       ? 4
+                                             : 2 * _size;
+    key_type *keys = new key_type[capacity];
+    value_type *values = nullptr;
+    try
+    {
+      values = new value_type[capacity];
+      for (size_type i = 0; i < index; ++i)
+      {
+        keys[i] = _keys[i];
+        values[i] = _values[i];
+      }
+      keys[index] = key;
+      values[index] = item;
+      for (size_type i = index; i < _size; ++i)
+      {
+        keys[i + 1] = _keys[i];
+        values[i + 1] = _values[i];
+      }
+    }
+    catch (...)
+    {
+      delete[] keys;
+      delete[] values;
+      throw;
+    }
+    replace(keys, values, _size + 1, capacity);
+    return true;
+  }
+
+  /**
+    @brief Rimozione di un record
+
+    Rimuove il primo record uguale a item secondo equal_policy tra quelli
+    con la stessa chiave. I record successivi vengono spostati indietro
+    di una posizione, senza riallocare.
+
+    @param item record da rimuovere
+
+    @return 0 if manages to remove
+    @return -1 if it fails
+  */
+  int remove(const value_type &item)
+  {
+    size_type index = get_index_of(item);
+    if (index == npos)
+      return -1;
+
+    if (in_place)
+    {
+      for (size_type i = index + 1; i < _size; ++i)
+      {
+        _keys[i - 1] = std::move(_keys[i]);
+        _values[i - 1] = std::move(_values[i]);
+      }
+      --_size;
+      return 0;
+    }
+
+    key_type *keys = new key_type[_capacity];
+    value_type *values = nullptr;
+    try
+    {
+      values = new value_type[_capacity];
+      for (size_type i = 0; i < index; ++i)
+      {
+        keys[i] = _keys[i];
+        values[i] = _values[i];
+      }
+      for (size_type i = index + 1; i < _size; ++i)
+      {
+        keys[i - 1] = _keys[i];
+        values[i - 1] = _values[i];
+      }
+    }
+    catch (...)
+    {
+      delete[] keys;
+      delete[] values;
+      throw;
+    }
+    replace(keys, values, _size - 1, _capacity);
+    return 0;
+  }
+
+  /**
+    @brief Riserva spazio per almeno n record
+
+    @param n numero di record da poter contenere senza riallocare
+  */
+  void reserve(size_type n)
+  {
+    if (n <= _capacity)
+      return;
+
+    key_type *keys = new key_type[n];
+    value_type *values = nullptr;
+    try
+    {
+      values = new value_type[n];
+      for (size_type i = 0; i < _size; ++i)
+      {
+        keys[i] = _keys[i];
+        values[i] = _values[i];
+      }
+    }
+    catch (...)
+    {
+      delete[] keys;
+      delete[] values;
+      throw;
+    }
+    replace(keys, values, _size, n);
+  }
+
+  /**
+    @brief Numero di record contenibili senza riallocare
+
+    @return capacita' delle colonne
+  */
+  size_type capacity() const
+  {
+    return _capacity;
+  }
+
+  /**
+    @brief Searchsorted sulla chiave
+
+    Legge solo la colonna delle chiavi.
+
+    @param key chiave da cercare
+
+    @return indice del primo record con chiave non minore di key
+  */
+  size_type searchsorted(const key_type &key) const
+  {
+    order_policy ord;
+    size_type under = 0;
+    size_type upper = _size;
+    while (under < upper)
+    {
+      size_type mid = under + (upper - under) / 2;
+      if (ord(_keys[mid], key))
+        under = mid + 1;
+      else
+        upper = mid;
+    }
+    return under;
+  }
+
+  /**
+    @brief Upper bound sulla chiave
+
+    @param key chiave da cercare
+
+    @return indice del primo record con chiave maggiore di key
+  */
+  size_type upper_bound(const key_type &key) const
+  {
+    order_policy ord;
+    size_type under = 0;
+    size_type upper = _size;
+    while (under < upper)
+    {
+      size_type mid = under + (upper - under) / 2;
+      if (ord(key, _keys[mid]))
+        upper = mid;
+      else
+        under = mid + 1;
+    }
+    return under;
+  }
+
+  /**
+    @brief find - ricerca un record se presente
+
+    @param target record da cercare
+
+    @return true se presente
+  */
+  bool find(const value_type &target) const
+  {
+    return get_index_of(target) != npos;
+  }
+
+  /**
+    @brief Verifica se esiste un record con la chiave data
+
+    @param key chiave da cercare
+
+    @return true se presente, senza leggere i record
+  */
+  bool contains(const key_type &key) const
+  {
+    order_policy ord;
+    size_type index = searchsorted(key);
+    return index < _size && !ord(key, _keys[index]);
+  }
+
+  /**
+    @brief Conta i record con chiave in [lo, hi)
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+
+    @return numero di record nell'intervallo, O(log n)
+  */
+  size_type range_count(const key_type &lo, const key_type &hi) const
+  {
+    size_type first = searchsorted(lo);
+    size_type last = searchsorted(hi);
+    return (last > first) ? last - first : 0;
+  }
+
+  /**
+    @brief Somma delle chiavi in [lo, hi)
+
+    Scorre solo la colonna delle chiavi, che e' densa.
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+
+    @return somma delle chiavi nell'intervallo, nel tipo Acc (default
+            key_type), O(log n + record nell'intervallo)
+  */
+  template <typename Acc = key_type>
+  Acc range_sum(const key_type &lo, const key_type &hi) const
+  {
+    size_type last = searchsorted(hi);
+    Acc sum = Acc();
+    for (size_type i = searchsorted(lo); i < last; ++i)
+      sum += static_cast<Acc>(_keys[i]);
+    return sum;
+  }
+
+  /**
+    @brief Chiave minima in [lo, hi)
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+
+    @return reference alla prima chiave dell'intervallo, O(log n)
+
+    @pre range_count(lo, hi) > 0
+  */
+  const key_type &range_min(const key_type &lo, const key_type &hi) const
+  {
+    size_type first = searchsorted(lo);
+    assert(first < searchsorted(hi));
+    return _keys[first];
+  }
+
+  /**
+    @brief Chiave massima in [lo, hi)
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+
+    @return reference all'ultima chiave dell'intervallo, O(log n)
+
+    @pre range_count(lo, hi) > 0
+  */
+  const key_type &range_max(const key_type &lo, const key_type &hi) const
+  {
+    size_type last = searchsorted(hi);
+    assert(searchsorted(lo) < last);
+    return _keys[last - 1];
+  }
+
+  /**
+    @brief Filtra i record in base alla sola chiave
+
+    Il predicato legge solo la colonna delle chiavi; i record vengono
+    copiati solo se selezionati, in colonne che crescono come in insert.
+
+    @param filt funtore booleano su key_type
+
+    @return KeyedSortedArray con i record selezionati
+  */
+  template <typename Policy>
+  KeyedSortedArray filter_key(Policy filt) const
+  {
+    KeyedSortedArray result;
+    for (size_type i = 0; i < _size; ++i)
+      if (filt(_keys[i]))
+        result.append(_keys[i], _values[i]);
+    return result;
+  }
+
+  /**
+    @brief Filter - filtra i record
+
+    @param filt funtore booleano su value_type
+
+    @return KeyedSortedArray con i record che soddisfano il filtro
+  */
+  template <typename Policy>
+  KeyedSortedArray filter(Policy filt) const
+  {
+    KeyedSortedArray result;
+    for (size_type i = 0; i < _size; ++i)
+      if (filt(_values[i]))
+        result.append(_keys[i], _values[i]);
+    return result;
+  }
+
+  /**
+    @brief makeEmpty - svuota
+
+    @post size() = 0
+  */
+  void makeEmpty()
+  {
+    delete[] _keys;
+    delete[] _values;
+    _keys = nullptr;
+    _values = nullptr;
+    _size = 0;
+    _capacity = 0;
+  }
+
+  /**
+    @brief Accesso alla dimensione dell'array
+
+    @return numero di record
+  */
+  size_type size(void) const
+  {
+    return _size;
+  }
+
+  /**
+    @brief Getter del record index-esimo
+
+    @param index della cella da leggere
+
+    @return reference al record
+
+    @pre index < size()
+  */
+  const value_type &operator[](size_type index) const
+  {
+    assert(index < _size);
+    return _values[index];
+  }
+
+  /**
+    @brief Getter della chiave index-esima
+
+    @param index della cella da leggere
+
+    @return reference alla chiave
+
+    @pre index < size()
+  */
+  const key_type &key(size_type index) const
+  {
+    assert(index < _size);
+    return _keys[index];
+  }
+
+  /**
+    @brief Colonna delle chiavi
+
+    @return puntatore all'array denso delle chiavi, lungo size()
+  */
+  const key_type *keys() const
+  {
+    return _keys;
+  }
+
+  /**
+    @brief Metodo swap per la classe KeyedSortedArray
+
+    @param other il KeyedSortedArray con cui scambiare il contenuto
+  */
+  void swap(KeyedSortedArray &other)
+  {
+    std::swap(_keys, other._keys);
+    std::swap(_values, other._values);
+    std::swap(_size, other._size);
+    std::swap(_capacity, other._capacity);
+  }
+
+  /**
+    @brief Iteratore random access sui record
+
+    E' costante: modificare un record potrebbe cambiarne la chiave
+    senza aggiornare la colonna delle chiavi.
+  */
+  class iterator
+  {
+  public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const T *pointer;
+    typedef const T &reference;
+
+    iterator() : ptr(nullptr)
+    {
+    }
+
+    // Ritorna il dato riferito dall'iteratore (dereferenziamento)
+    reference operator*() const
+    {
+      return *ptr;
+    }
+
+    // Ritorna il puntatore al dato riferito dall'iteratore
+    pointer operator->() const
+    {
+      return ptr;
+    }
+
+    // Operatore di accesso random
+    reference operator[](difference_type index) const
+    {
+      return ptr[index];
+    }
+
+    // Operatore di iterazione post-incremento
+    iterator operator++(int)
+    {
+      iterator old(*this);
+      ++ptr;
+      return old;
+    }
+
+    // Operatore di iterazione pre-incremento
+    iterator &operator++()
+    {
+      ++ptr;
+      return *this;
+    }
+
+    // Operatore di iterazione post-decremento
+    iterator operator--(int)
+    {
+      iterator old(*this);
+      --ptr;
+      return old;
+    }
+
+    // Operatore di iterazione pre-decremento
+    iterator &operator--()
+    {
+      --ptr;
+      return *this;
+    }
+
+    // Spostamentio in avanti della posizione
+    iterator operator+(difference_type offset) const
+    {
+      return iterator(ptr + offset);
+    }
+
+    // Spostamentio all'indietro della posizione
+    iterator operator-(difference_type offset) const
+    {
+      return iterator(ptr - offset);
+    }
+
+    // Spostamentio in avanti della posizione
+    iterator &operator+=(difference_type offset)
+    {
+      ptr += offset;
+      return *this;
+    }
+
+    // Spostamentio all'indietro della posizione
+    iterator &operator-=(difference_type offset)
+    {
+      ptr -= offset;
+      return *this;
+    }
+
+    // Numero di elementi tra due iteratori
+    difference_type operator-(const iterator &other) const
+    {
+      return ptr - other.ptr;
+    }
+
+    // Uguaglianza
+    bool operator==(const iterator &other) const
+    {
+      return ptr == other.ptr;
+    }
+
+    // Diversita'
+    bool operator!=(const iterator &other) const
+    {
+      return ptr != other.ptr;
+    }
+
+    // Confronto
+    bool operator>(const iterator &other) const
+    {
+      return ptr > other.ptr;
+    }
+
+    bool operator>=(const iterator &other) const
+    {
+      return ptr >= other.ptr;
+    }
+
+    // Confronto
+    bool operator<(const iterator &other) const
+    {
+      return ptr < other.ptr;
+    }
+
+    // Confronto
+    bool operator<=(const iterator &other) const
+    {
+      return ptr <= other.ptr;
+    }
+
+  private:
+    const T *ptr;
+    friend class KeyedSortedArray;
+
+    iterator(const T *p) : ptr(p)
+    {
+    }
+  }; // classe iterator
+
+  typedef iterator const_iterator;
+
+  /**
+    @brief Iteratore inizio sequenza
+
+    @return iteratore
+  */
+  iterator begin() const
+  {
+    return iterator(_values);
+  }
+
+  /**
+    @brief Iteratore fine sequenza
+
+    @return iteratore
+  */
+  iterator end() const
+  {
+    return iterator(_values + _size);
+  }
+
+private:
+  // indice non valido, usato come "non trovato"
+  static const size_type npos = static_cast<size_type>(-1);
+
+  // gli spostamenti in place non devono poter lanciare a meta'
+  static const bool in_place = std::is_nothrow_move_assignable<key_type>::value &&
+                               std::is_nothrow_move_assignable<value_type>::value;
+
+  // primo record uguale a target tra quelli con la sua chiave, npos se non c'e'
+  size_type get_index_of(const value_type &target) const
+  {
+    key_extractor key_of;
+    order_policy ord;
+    equal_policy eq;
+    key_type key = key_of(target);
+    for (size_type i = searchsorted(key); i < _size && !ord(key, _keys[i]); ++i)
+      if (eq(target, _values[i]))
+        return i;
+    return npos;
+  }
+
+  // aggiunge un record in coda (chiave non minore dell'ultima); la
+  // capacita' cresce come in insert
+  void append(const key_type &key, const value_type &item)
+  {
+    if (_size == _capacity)
+      reserve((_size < 4) ? 4 : 2 * _size);
+    _keys[_size] = key;
+    _values[_size] = item;
+    ++_size;
+  }
+
+  // sostituisce il contenuto con colonne gia' pronte
+  void replace(key_type *keys, value_type *values, size_type size, size_type capacity)
+  {
+    delete[] _keys;
+    delete[] _values;
+    _keys = keys;
+    _values = values;
+    _size = size;
+    _capacity = capacity;
+  }
+
+  key_type *_keys;
+  value_type *_values;
+  size_type _size;
+  size_type _capacity; // record allocati in entrambe le colonne
+};
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef LearnedIndex_H
+#define LearnedIndex_H
+
+#include <cstddef> // std::size_t
+#include <limits>  // std::numeric_limits
+
+/**
+  @file learnedindex.h
+  @brief Dichiarazione della classe LearnedIndex
+*/
+
+/**
+  @brief Classe LearnedIndex
+
+  Modello lineare a tratti (stile PGM) che, data una chiave numerica,
+  predice la sua posizione in un array ordinato con errore massimo epsilon
+  sulle chiavi usate per l'addestramento.
+
+  Il modello viene costruito in un solo passaggio con l'algoritmo del cono
+  che si restringe: un segmento viene esteso finche' esiste una pendenza
+  che mantiene tutti i suoi punti entro +-epsilon, poi se ne apre uno nuovo.
+  Ogni segmento occupa 3 double, quindi qualche migliaio di segmenti
+  stanno in pochi KB.
+
+  L'array puo' essere crescente o decrescente; se non e' monotono rispetto
+  al valore numerico delle chiavi la build fallisce e il modello non va
+  usato.
+
+  @param T tipo aritmetico delle chiavi
+*/
+template <typename T>
+class LearnedIndex
+{
+public:
+  typedef std::size_t size_type;
+
+  LearnedIndex() : _segments(nullptr), _count(0), _epsilon(0), _sign(1) {}
+
+  ~LearnedIndex()
+  {
+    delete[] _segments;
+  }
+
+  LearnedIndex(const LearnedIndex &other) = delete;
+  LearnedIndex &operator=(const LearnedIndex &other) = delete;
+
+  /**
+    @brief Costruisce il modello
+
+    @param data array ordinato su cui addestrare il modello
+    @param n numero di elementi di data
+    @param epsilon errore massimo ammesso sulle posizioni
+
+    @return true se il modello e' utilizzabile
+  */
+  bool build(const T *data, size_type n, size_type epsilon)
+  {
+    delete[] _segments;
+    _segments = nullptr;
+    _count = 0;
+    _epsilon = epsilon;
+
+    if (n == 0)
+      return false;
+
+    _sign = (static_cast<double>(data[n - 1]) < static_cast<double>(data[0])) ? -1 : 1;
+
+    // al massimo un segmento ogni due chiavi distinte, piu' l'ultimo
+    size_type capacity = n / 2 + 1;
+    segment *tmp = new segment[capacity];
+
+    const double eps = static_cast<double>(epsilon);
+    double x0 = key(data[0]);
+    double y0 = 0;
+    double slope_lo = 0;
+    double slope_hi = std::numeric_limits<double>::infinity();
+    double prev = x0;
+
+    for (size_type i = 1; i < n; ++i)
+    {
+      double x = key(data[i]);
+      if (x == prev)
+        continue; // duplicati: conta solo la prima posizione
+      if (!(x > prev))
+      {
+        // non monotono (o NaN): il modello non e' applicabile
+        delete[] tmp;
+        _count = 0;
+        return false;
+      }
+      prev = x;
+
+      double y = static_cast<double>(i);
+      double dx = x - x0;
+      double lo = (y - eps - y0) / dx;
+      double hi = (y + eps - y0) / dx;
+
+      if (lo > slope_hi || hi < slope_lo)
+      {
+        tmp[_count++] = close(x0, y0, slope_lo, slope_hi);
+        x0 = x;
+        y0 = y;
+        slope_lo = 0;
+        slope_hi = std::numeric_limits<double>::infinity();
+      }
+      else
+      {
+        if (lo > slope_lo)
+          slope_lo = lo;
+        if (hi < slope_hi)
+          slope_hi = hi;
+      }
+    }
+    tmp[_count++] = close(x0, y0, slope_lo, slope_hi);
+
+    // ricopio in un blocco della dimensione esatta
+    _segments = new segment[_count];
+    for (size_type s = 0; s < _count; ++s)
+      _segments[s] = tmp[s];
+    delete[] tmp;
+    return true;
+  }
+
+  /**
+    @brief Predice la posizione di una chiave
+
+    @param item chiave da cercare
+    @param n numero di elementi dell'array su cui e' stato costruito
+
+    @return posizione stimata in [0, n]
+
+    @pre il modello e' stato costruito con successo
+  */
+  size_type predict(const T &item, size_type n) const
+  {
+    double x = key(item);
+
+    // ultimo segmento con chiave iniziale <= x
+    size_type under = 0;
+    size_type upper = _count;
+    while (under < upper)
+    {
+      size_type mid = under + (upper - under) / 2;
+      if (_segments[mid].key <= x)
+        under = mid + 1;
+      else
+        upper = mid;
+    }
+    const segment &s = _segments[under == 0 ? 0 : under - 1];
+
+    double pos = s.intercept + s.slope * (x - s.key);
+    if (!(pos > 0)) // anche NaN
+      return 0;
+    if (pos >= static_cast<double>(n))
+      return n;
+    return static_cast<size_type>(pos);
+  }
+
+  /**
+    @brief Errore massimo del modello
+
+    @return epsilon usato nell'ultima build
+  */
+  size_type epsilon() const
+  {
+    return _epsilon;
+  }
+
+  /**
+    @brief Numero di segmenti del modello
+
+    @return numero di segmenti
+  */
+  size_type segments() const
+  {
+    return _count;
+  }
+
+  /**
+    @brief Memoria occupata dai segmenti
+
+    @return dimensione in byte
+  */
+  size_type bytes() const
+  {
+    return _count * sizeof(segment);
+  }
+
+private:
+  struct segment
+  {
+    double key;       // prima chiave coperta dal segmento
+    double slope;     // pendenza
+    double intercept; // posizione della prima chiave
+  };
+
+  double key(const T &item) const
+  {
+    return _sign * static_cast<double>(item);
+  }
+
+  static segment close(double x0, double y0, double lo, double hi)
+  {
+    segment s;
+    s.key = x0;
+    s.intercept = y0;
+    s.slope = (hi == std::numeric_limits<double>::infinity()) ? lo : (lo + hi) / 2;
+    return s;
+  }
+
+  segment *_segments;
+  size_type _count;
+  size_type _epsilon;
+  int _sign;
+};
+
+#endif
@@ -6,7 +6,18 @@
 #include <iostream>
 #include <fstream>
 #include "sortedarray.h" // SortedArray<int>
+#include "keyedsortedarray.h"
+#include "externalsortedarray.h"
+#include "mergejoin.h"
 #include <cassert>       // assert
+#include <algorithm>     // std::lower_bound
+#include <vector>        // std::vector
+#include <thread>        // std::thread
+#include <climits>       // INT_MAX
+#if __cplusplus >= 202002L
+#include <span>
+#include <ranges>
+#endif
 
 struct lessThen100
 {
@@ -64,6 +75,51 @@ struct NameEqualPolicy
   }
 };
 
+// confronti tra Person ed eta', senza costruire un Person per cercare
+struct TransparentAgeOrder
+{
+  typedef void is_transparent;
+
+  bool operator()(const Person &p1, const Person &p2) const
+  {
+    return p1.age < p2.age;
+  }
+  bool operator()(const Person &p, int age) const
+  {
+    return p.age < age;
+  }
+  bool operator()(int age, const Person &p) const
+  {
+    return age < p.age;
+  }
+};
+
+struct TransparentAgeEqual
+{
+  typedef void is_transparent;
+
+  bool operator()(const Person &p1, const Person &p2) const
+  {
+    return p1.age == p2.age;
+  }
+  bool operator()(const Person &p, int age) const
+  {
+    return p.age == age;
+  }
+  bool operator()(int age, const Person &p) const
+  {
+    return age == p.age;
+  }
+};
+
+struct AgeKey
+{
+  int operator()(const Person &p) const
+  {
+    return p.age;
+  }
+};
+
 std::ostream &operator<<(std::ostream &os, const Person &person)
 {
   os << "Name: " << person.name << ", Age: " << person.age;
@@ -107,7 +163,7 @@ void test2()
 
   SortedArray<Person, AgeOrderPolicy, NameEqualPolicy> f = arr.filter([](const Person &p)                                                          { return p.age > 25; });
 
-  for (int i = 0; i < f.size(); ++i)
+  for (std::size_t i = 0; i < f.size(); ++i)
   {
     assert(f[i].age > 25);
   }
@@ -130,7 +186,7 @@ void test1()
 
   // Test copy constructor
   SortedArray<int, std::less<int>, std::equal_to<int>> arr2(arr);
-  for (int i = 0; i < arr2.size(); i++)
+  for (std::size_t i = 0; i < arr2.size(); i++)
     assert(arr[i] == arr2[i]);
 
   // Test iterator constructor
@@ -152,7 +208,7 @@ void test1()
                                                                              { return num % 2 == 0; });
 
   // Print the elements of the filtered array
-  for (int i = 0; i < filtered.size(); ++i)
+  for (std::size_t i = 0; i < filtered.size(); ++i)
     std::cout << filtered[i] << " ";
   std::cout << std::endl;
 }
@@ -257,7 +313,7 @@ void test0()
 
   // 4. Un metodo per rimuovere un dato elemento T. Se più elementi sono
   // rimovibili, ne viene rimosso solo uno;
-  int a = db1.size();
+  std::size_t a = db1.size();
   std::cout << db1;
   db1.remove(-1);
   db1.remove(5);
@@ -327,10 +383,1044 @@ void test0()
   std::cout << s << std::endl;
 }
 
+void test4()
+{
+  std::cout << "*** TEST STRATEGIE DI RICERCA ***" << std::endl;
+
+  typedef SortedArray<int, std::less<int>, std::equal_to<int>> IntArray;
+  typedef SortedArray<double, DescendingOrd, Equalz> DoubleArray;
+
+  // chiavi uniformi con duplicati
+  IntArray uni;
+  for (int i = 0; i < 2000; ++i)
+    uni.insert((i * 7919) % 1000 * 3);
+
+  IntArray bin(uni);
+  assert(uni.get_search_mode() == IntArray::search_binary);
+
+  uni.set_search_mode(IntArray::search_interpolation);
+  for (int k = -5; k < 3005; ++k)
+    assert(uni.searchsorted(k) == bin.searchsorted(k));
+
+  uni.set_search_mode(IntArray::search_adaptive);
+  for (int k = -5; k < 3005; ++k)
+    assert(uni.searchsorted(k) == bin.searchsorted(k));
+
+  // chiavi fortemente sbilanciate, ordine decrescente
+  DoubleArray skew;
+  skew.set_search_mode(DoubleArray::search_adaptive);
+  for (int i = 0; i < 500; ++i)
+    skew.insert(i * i * i);
+  DoubleArray skew_bin(skew);
+  skew_bin.set_search_mode(DoubleArray::search_binary);
+  for (int k = 0; k < 500; ++k)
+  {
+    assert(skew.searchsorted(k * k * k) == skew_bin.searchsorted(k * k * k));
+    assert(skew.searchsorted(k * k * k + 1) == skew_bin.searchsorted(k * k * k + 1));
+  }
+}
+
+void test5()
+{
+  std::cout << "*** TEST INDICE APPRESO ***" << std::endl;
+
+  typedef SortedArray<int, std::less<int>, std::equal_to<int>> IntArray;
+  typedef SortedArray<double, DescendingOrd, Equalz> DoubleArray;
+
+  IntArray arr;
+  for (int i = 0; i < 3000; ++i)
+    arr.insert((i * 7919) % 3000 * (i % 3 + 1));
+
+  IntArray ref(arr);
+  arr.enable_learned_index(8);
+  for (int k = -5; k < 9005; ++k)
+    assert(arr.searchsorted(k) == ref.searchsorted(k));
+  assert(arr.learned_index_bytes() > 0);
+
+  // il modello si ricostruisce dopo una modifica
+  arr.insert(4500);
+  ref.insert(4500);
+  assert(arr.learned_index_bytes() == 0);
+  for (int k = 4400; k < 4600; ++k)
+    assert(arr.searchsorted(k) == ref.searchsorted(k));
+
+  // piu' thread che cercano insieme costruiscono il modello una volta sola
+  arr.insert(4501);
+  ref.insert(4501);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; ++t)
+    readers.push_back(std::thread([&arr, &ref, t]()
+                                  {
+                                    for (int k = t; k < 9005; k += 4)
+                                      assert(arr.searchsorted(k) == ref.searchsorted(k));
+                                  }));
+  for (std::size_t t = 0; t < readers.size(); ++t)
+    readers[t].join();
+  assert(arr.learned_index_bytes() > 0);
+
+  arr.disable_learned_index();
+  assert(arr.learned_index_bytes() == 0);
+
+  DoubleArray desc;
+  for (int i = 0; i < 1000; ++i)
+    desc.insert(i * 0.5);
+  DoubleArray desc_ref(desc);
+  desc.enable_learned_index(4);
+  for (int k = -10; k < 1010; ++k)
+    assert(desc.searchsorted(k * 0.25) == desc_ref.searchsorted(k * 0.25));
+}
+
+void test6()
+{
+  std::cout << "*** TEST AGGREGATI SU INTERVALLI ***" << std::endl;
+
+  SortedArray<int, std::less<int>, std::equal_to<int>> arr;
+  for (int i = 1; i <= 100; ++i)
+    arr.insert(i);
+
+  assert(arr.range_count(10, 20) == 10);
+  assert(arr.range_count(20, 10) == 0);
+  assert(arr.range_sum(1, 101) == 5050);
+  assert(arr.range_sum(10, 20) == 145);
+  assert(arr.range_sum(200, 300) == 0);
+  assert(arr.range_min(10, 20) == 10);
+  assert(arr.range_max(10, 20) == 19);
+
+  // le somme prefisse vengono ricalcolate dopo una modifica
+  arr.insert(15);
+  arr.remove(11);
+  assert(arr.range_sum(10, 20) == 149);
+  assert(arr.range_count(15, 16) == 2);
+
+  SortedArray<double, DescendingOrd, Equalz> desc;
+  desc.insert(1.5);
+  desc.insert(2.5);
+  desc.insert(4);
+  // in ordine decrescente l'intervallo [lo, hi) va da lo verso hi
+  assert(desc.range_count(4, 1.5) == 2);
+  assert(desc.range_sum(4, 1.5) == 6.5);
+  assert(desc.range_min(4, 1.5) == 4);
+
+  // vicino al limite di int: la somma va accumulata in un tipo piu' largo
+  SortedArray<int, std::less<int>, std::equal_to<int>> big;
+  big.insert(INT_MAX / 2);
+  big.insert(INT_MAX / 2 + 1);
+  big.insert(INT_MAX - 1);
+  // INT_MAX / 2 + (INT_MAX / 2 + 1) == INT_MAX: ancora rappresentabile
+  assert(big.range_sum(0, INT_MAX - 1) == INT_MAX);
+  assert(big.range_sum<long long>(0, INT_MAX - 1) == INT_MAX);
+  // un elemento in piu' supera INT_MAX, in long long la somma e' esatta
+  assert(big.range_sum<long long>(0, INT_MAX) == INT_MAX + (INT_MAX - 1LL));
+  big.insert(0);
+  assert(big.range_sum<long long>(0, INT_MAX) == INT_MAX + (INT_MAX - 1LL));
+
+  // proiezione su un campo
+  SortedArray<Person, AgeOrderPolicy, NameEqualPolicy> people;
+  people.insert(Person("John", 25));
+  people.insert(Person("Alice", 30));
+  people.insert(Person("Bob", 20));
+  AgeKey age;
+  assert(people.range_sum<int>(Person("", 21), Person("", 99), age) == 55);
+  assert(people.range_sum<double>(Person("", 0), Person("", 99), age) == 75.0);
+
+  // somme prefisse anche per un Acc piu' largo e per proiezioni senza
+  // stato; la proiezione con stato scorre l'intervallo
+  int weight = 3;
+  auto odd = [](int x)
+  { return x % 2; };
+  auto weighted = [&weight](int x)
+  { return weight * x; };
+  auto mod7 = [](int x)
+  { return x % 7; };
+  auto mod_weight = [&weight](int x)
+  { return x % (weight + 4); };
+  for (int lo = 0; lo <= 101; lo += 7)
+    for (int hi = lo; hi <= 102; hi += 5)
+    {
+      long long sum = 0;
+      int odds = 0;
+      int first = -1, low = -1, high = -1;
+      for (int i = 0; i < static_cast<int>(arr.size()); ++i)
+        if (arr[i] >= lo && arr[i] < hi)
+        {
+          sum += arr[i];
+          odds += arr[i] % 2;
+          if (first < 0)
+            first = low = high = i;
+          if (arr[i] % 7 < arr[low] % 7)
+            low = i;
+          if (arr[i] % 7 > arr[high] % 7)
+            high = i;
+        }
+      assert(arr.range_sum<long long>(lo, hi) == sum);
+      assert(arr.range_sum<int>(lo, hi, odd) == odds);
+      assert(arr.range_sum<long long>(lo, hi, weighted) == 3 * sum);
+      if (first < 0)
+        continue;
+      // a parita' vince il primo: lo dicono gli indirizzi
+      assert(&arr.range_min(lo, hi, mod7) == &arr[low]);
+      assert(&arr.range_max(lo, hi, mod7) == &arr[high]);
+      assert(&arr.range_min(lo, hi, mod_weight) == &arr[low]);
+      assert(&arr.range_max(lo, hi, mod_weight) == &arr[high]);
+    }
+#ifdef SORTEDARRAY_STATS
+  // le tabelle si costruiscono una volta sola fino alla modifica successiva
+  unsigned long long allocations = arr.stats().allocations;
+  arr.range_sum<long long>(0, 50);
+  arr.range_min(0, 50, mod7);
+  assert(arr.stats().allocations == allocations);
+#endif
+  arr.insert(49);
+  assert(arr.range_sum<long long>(40, 50) == 40 + 41 + 42 + 43 + 44 + 45 + 46 + 47 + 48 + 49 + 49);
+  assert(arr.range_max(40, 50, mod7) == 41);
+
+  // con run_length_policy ogni run pesa per le sue ripetizioni
+  SortedArray<int, std::less<int>, std::equal_to<int>, run_length_policy> runs;
+  for (int k = 0; k < 3; ++k)
+    runs.insert(INT_MAX - 1);
+  runs.insert(1);
+  assert(runs.range_sum<long long>(0, INT_MAX) == 3LL * (INT_MAX - 1) + 1);
+  assert(runs.range_sum<long long>(0, INT_MAX, [](int x)
+                                   { return x % 2; }) == 1);
+  // cambiano solo le ripetizioni: le somme pesate vanno ricalcolate
+  runs.insert(1);
+  assert(runs.range_sum<long long>(0, INT_MAX) == 3LL * (INT_MAX - 1) + 2);
+  assert(runs.range_min(0, INT_MAX, odd) == INT_MAX - 1);
+  assert(runs.range_max(0, INT_MAX, odd) == 1);
+}
+
+// confronti contati a parte, per verificare il contatore comparisons
+unsigned long long counted = 0;
+
+struct CountedOrd
+{
+  bool operator()(const int &a, const int &b) const
+  {
+    ++counted;
+    return a < b;
+  }
+};
+
+struct CountedEq
+{
+  bool operator()(const int &a, const int &b) const
+  {
+    ++counted;
+    return a == b;
+  }
+};
+
+void test7()
+{
+  std::cout << "*** TEST CONTATORI ***" << std::endl;
+
+  SortedArray<int, AscendingOrd, Equalz> arr;
+  for (int i = 0; i < 64; ++i)
+    arr.insert(i);
+  arr.searchsorted(10);
+  arr.filter(lessThen100());
+  arr.filter([](int x)
+             { return x < 16; });
+
+  const sortedarray_stats &st = arr.stats();
+#ifdef SORTEDARRAY_STATS
+  assert(st.inserts == 64);
+  assert(st.allocations <= 6); // crescita geometrica: 4, 8, 16, 32, 64
+  assert(st.searches == 65);
+  assert(st.max_probes >= 6);
+  assert(st.filter_tested == 128);
+  assert(st.filter_selected == 80);
+  assert(st.filter_selectivity() == 80.0 / 128);
+  arr.reset_stats();
+  assert(arr.stats().searches == 0);
+
+  // ogni confronto contato una volta sola, ogni ricerca delimitata
+  SortedArray<int, CountedOrd, CountedEq> cmp;
+  for (int i = 0; i < 64; ++i)
+    cmp.insert(i / 2);
+  cmp.set_bound(80);
+  for (int i = 0; i < 20; ++i)
+    cmp.insert(i);
+  cmp.reset_stats();
+  counted = 0;
+  assert(cmp.find(7) && !cmp.find(100));
+  assert(cmp.count(3) == 3 && cmp.count(-1) == 0);
+  assert(cmp.erase_all(5) == 3);
+  assert(cmp.trim_above(29) == 4);
+  cmp.insert(-5);
+  assert(cmp.stats().comparisons == counted);
+  assert(cmp.stats().searches == 8);
+#else
+  // senza SORTEDARRAY_STATS i contatori restano a zero
+  assert(st.searches == 0 && st.allocations == 0 && st.comparisons == 0);
+#endif
+}
+
+void test8()
+{
+  std::cout << "*** TEST POLITICHE SUI DUPLICATI ***" << std::endl;
+
+  int data[] = {3, 1, 3, 2, 3, 1, 5};
+
+  // multiset: comportamento di sempre
+  SortedArray<int, AscendingOrd, Equalz> multi(data, data + 7);
+  assert(multi.size() == 7);
+  assert(multi.count(3) == 3);
+  assert(multi.count(4) == 0);
+
+  // unique: i duplicati vengono rifiutati
+  SortedArray<int, AscendingOrd, Equalz, unique_policy> uniq(data, data + 7);
+  assert(uniq.size() == 4);
+  assert(!uniq.insert(2));
+  assert(uniq.insert(4));
+  assert(uniq.count(3) == 1);
+  assert(uniq.remove(3) == 0);
+  assert(!uniq.find(3));
+
+  // run-length: stessa vista logica del multiset
+  SortedArray<int, AscendingOrd, Equalz, run_length_policy> rle(data, data + 7);
+  assert(rle.size() == 7);
+  assert(rle.runs() == 4);
+  assert(rle.count(3) == 3);
+  for (unsigned int i = 0; i < rle.size(); ++i)
+    assert(rle[i] == multi[i]);
+  int i = 0;
+  for (auto it = rle.begin(); it != rle.end(); ++it, ++i)
+    assert(*it == multi[i]);
+  assert(*(rle.end() - 2) == 3);
+  assert(rle.end() - rle.begin() == 7);
+  assert(rle.searchsorted(3) == multi.searchsorted(3));
+  assert(rle.searchsorted(4) == multi.searchsorted(4));
+
+  assert(rle.remove(3) == 0);
+  assert(rle.count(3) == 2 && rle.runs() == 4);
+  assert(rle.remove(5) == 0);
+  assert(rle.runs() == 3 && rle.size() == 5);
+  assert(rle.remove(7) == -1);
+
+  for (int k = 0; k < 1000; ++k)
+    rle.insert(k % 3);
+  assert(rle.runs() == 4);
+  assert(rle.size() == 1005);
+  assert(rle.count(0) == 334);
+
+  SortedArray<int, AscendingOrd, Equalz, run_length_policy> odd = rle.filter([](int x)
+                                                                            { return x % 2 == 1; });
+  assert(odd.runs() == 2);
+  assert(odd.size() == rle.count(1) + rle.count(3));
+
+  // conversione tra politiche diverse
+  SortedArray<int, AscendingOrd, Equalz> expanded(odd);
+  assert(expanded.size() == odd.size());
+  SortedArray<double, DescendingOrd, Equalz, unique_policy> distinct(rle);
+  assert(distinct.size() == 4);
+  std::cout << odd.runs() << " run, " << distinct;
+
+  // stessa interfaccia del multiset, confrontata su dati con molti duplicati
+  typedef SortedArray<int, AscendingOrd, Equalz, run_length_policy> RunArray;
+  RunArray runs;
+  SortedArray<int, AscendingOrd, Equalz> ref;
+  runs.set_search_mode(RunArray::search_adaptive);
+  assert(runs.get_search_mode() == RunArray::search_adaptive);
+  for (int k = 0; k < 3000; ++k)
+  {
+    int v = (k * 7919) % 500;
+    runs.insert(v);
+    ref.insert(v);
+  }
+  assert(runs.size() == ref.size() && runs.runs() == 500);
+  assert(runs.capacity() >= runs.runs() && runs.capacity() < 2 * runs.runs());
+  for (int v = -5; v < 505; v += 7)
+  {
+    assert(runs.searchsorted(v) == ref.searchsorted(v));
+    assert(runs.count(v) == ref.count(v));
+    assert(runs.range_count(v, v + 40) == ref.range_count(v, v + 40));
+    assert(runs.range_sum(v, v + 40) == ref.range_sum(v, v + 40));
+  }
+  assert(runs.range_min(100, 200) == 100 && runs.range_max(100, 200) == 199);
+#ifdef SORTEDARRAY_STATS
+  // 500 run nuove con crescita geometrica: poche allocazioni
+  assert(runs.stats().inserts == 500 && runs.stats().allocations < 12);
+#endif
+
+  // rimozioni per intervallo, predicato, iteratore e trim
+  assert(runs.erase_range(10, 20) == ref.erase_range(10, 20));
+  assert(runs.erase_all(30) == ref.erase_all(30));
+  assert(runs.erase_if([](int x) { return x % 50 == 7; }) ==
+         ref.erase_if([](int x) { return x % 50 == 7; }));
+  runs.erase(runs.begin() + 3, runs.begin() + 20);
+  ref.erase(ref.begin() + 3, ref.begin() + 20);
+  assert(runs.trim_below(5) == ref.trim_below(5));
+  assert(runs.trim_above(480) == ref.trim_above(480));
+  assert(runs.size() == ref.size());
+  for (std::size_t i = 0; i < ref.size(); ++i)
+    assert(runs[i] == ref[i]);
+  i = static_cast<int>(ref.size());
+  for (auto it = runs.rbegin(); it != runs.rend(); ++it)
+    assert(*it == ref[--i]);
+
+  // inserimenti con hint e cursore, copie in coda senza ricostruire l'albero
+  runs.insert(runs.end(), 1000);
+  RunArray::cursor cur(runs);
+  cur.seek(100);
+  cur.insert(100);
+  cur.insert(1000);
+  assert(runs.count(100) == 7 && runs.count(1000) == 2);
+  assert(*(runs.lower_bound(runs.begin(), 1000)) == 1000);
+  RunArray copy(runs);
+  copy.swap(runs);
+  assert(runs.size() == copy.size() && runs.find(1000) && !runs.find(10));
+}
+
+void test9()
+{
+  std::cout << "*** TEST KEYEDSORTEDARRAY ***" << std::endl;
+
+  Person data[] = {Person("John", 25), Person("Alice", 30), Person("Bob", 20),
+                   Person("Jane", 35), Person("Tom", 30)};
+  KeyedSortedArray<Person, AgeKey, std::less<int>, NameEqualPolicy> people(data, data + 5);
+  assert(people.size() == 5);
+
+  // la colonna delle chiavi e' densa e ordinata
+  const int *ages = people.keys();
+  for (unsigned int i = 1; i < people.size(); ++i)
+    assert(ages[i - 1] <= ages[i]);
+  assert(people.key(0) == 20 && people[0].name == "Bob");
+
+  // ricerche per chiave intera, senza costruire Person
+  assert(people.contains(30));
+  assert(!people.contains(31));
+  assert(people.searchsorted(30) == 2);
+  assert(people.upper_bound(30) == 4);
+  assert(people.range_count(21, 31) == 3);
+
+  KeyedSortedArray<Person, AgeKey, std::less<int>, NameEqualPolicy> young =
+      people.filter_key([](int age)
+                        { return age < 30; });
+  assert(young.size() == 2);
+
+  assert(people.find(Person("Tom", 30)));
+  assert(people.remove(Person("Tom", 30)) == 0);
+  assert(people.remove(Person("Tom", 30)) == -1);
+  assert(people.size() == 4);
+
+  KeyedSortedArray<Person, AgeKey, std::less<int>, NameEqualPolicy> copy(people);
+  copy = young;
+  assert(copy.size() == 2);
+
+  for (auto it = people.begin(); it != people.end(); ++it)
+    std::cout << *it << std::endl;
+
+  // aggregati sulla colonna delle chiavi: eta' 20, 25, 30, 35
+  assert(people.range_sum(21, 36) == 90);
+  assert(people.range_sum<long long>(0, 100) == 110);
+  assert(people.range_sum(40, 50) == 0);
+  assert(people.range_min(21, 36) == 25 && people.range_max(21, 36) == 35);
+
+  // crescita geometrica: le colonne si riallocano O(log n) volte
+  KeyedSortedArray<Person, AgeKey, std::less<int>, NameEqualPolicy> crowd;
+  std::size_t reallocations = 0;
+  for (int i = 0; i < 1000; ++i)
+  {
+    std::size_t before = crowd.capacity();
+    crowd.insert(Person("P", (i * 37) % 100));
+    if (crowd.capacity() != before)
+      ++reallocations;
+  }
+  assert(crowd.size() == 1000 && reallocations <= 10);
+  std::size_t full = crowd.capacity();
+  for (int i = 0; i < 500; ++i)
+    assert(crowd.remove(Person("P", i % 100)) == 0);
+  assert(crowd.size() == 500 && crowd.capacity() == full);
+  for (std::size_t i = 1; i < crowd.size(); ++i)
+    assert(crowd.key(i - 1) <= crowd.key(i) && crowd[i].age == crowd.key(i));
+  crowd.reserve(4000);
+  assert(crowd.capacity() == 4000 && crowd.size() == 500 && crowd.contains(99));
+
+  // i risultati dei filtri non ereditano la capacita' dell'originale
+  KeyedSortedArray<Person, AgeKey, std::less<int>, NameEqualPolicy> few =
+      crowd.filter_key([](int age)
+                       { return age == 99; });
+  assert(few.size() == 5 && few.capacity() < 16 && few.key(4) == 99);
+  few = crowd.filter([](const Person &p)
+                     { return p.age >= 98; });
+  assert(few.size() == 10 && few.capacity() < 32 && few.contains(98));
+  for (std::size_t i = 1; i < few.size(); ++i)
+    assert(few.key(i - 1) <= few.key(i));
+}
+
+void test10()
+{
+  std::cout << "*** TEST COPY-ON-WRITE ***" << std::endl;
+
+  SortedArray<int, AscendingOrd, Equalz> a;
+  for (int i = 0; i < 10; ++i)
+    a.insert(i);
+
+  // le copie condividono il buffer finche' non vengono modificate
+  SortedArray<int, AscendingOrd, Equalz> b(a);
+  SortedArray<int, AscendingOrd, Equalz> c;
+  c = b;
+  assert(&a[0] == &b[0] && &b[0] == &c[0]);
+
+  b.insert(100);
+  assert(&a[0] != &b[0] && &a[0] == &c[0]);
+  assert(a.size() == 10 && b.size() == 11 && c.size() == 10);
+
+  c.remove(5);
+  assert(!c.find(5) && a.find(5));
+
+  a.makeEmpty();
+  assert(b.size() == 11 && b[10] == 100);
+}
+
+void test11()
+{
+  std::cout << "*** TEST CANCELLAZIONI IN BLOCCO ***" << std::endl;
+
+  SortedArray<int, AscendingOrd, Equalz> arr;
+  for (int i = 0; i < 100; ++i)
+    arr.insert(i % 50);
+  SortedArray<int, AscendingOrd, Equalz> shared(arr);
+
+  // tutte le occorrenze di una chiave in un passaggio
+  assert(arr.erase_all(7) == 2);
+  assert(!arr.find(7) && arr.size() == 98);
+  assert(arr.erase_all(7) == 0);
+
+  // intervallo di chiavi [10, 20)
+  assert(arr.erase_range(10, 20) == 20);
+  assert(arr.range_count(0, 50) == 78);
+  assert(!arr.find(10) && !arr.find(19) && arr.find(20));
+
+  // predicato: via i multipli di 3
+  unsigned int removed = arr.erase_if([](int x)
+                                      { return x % 3 == 0; });
+  assert(removed == 28 && arr.size() == 50);
+  for (unsigned int i = 0; i < arr.size(); ++i)
+  {
+    assert(arr[i] % 3 != 0);
+    if (i > 0)
+      assert(arr[i - 1] <= arr[i]);
+  }
+
+  // intervallo di iteratori
+  auto it = arr.erase(arr.begin() + 2, arr.begin() + 6);
+  assert(arr.size() == 46 && *it == arr[2]);
+  it = arr.erase(arr.begin());
+  assert(arr.size() == 45 && *it == arr[0]);
+
+  // la copia condivisa non viene toccata
+  assert(shared.size() == 100 && shared.count(7) == 2);
+
+  assert(arr.erase_if([](int)
+                      { return true; }) == 45);
+  assert(arr.size() == 0);
+  arr.insert(1);
+  assert(arr.size() == 1);
+}
+
+int sum_of(const int *values, unsigned int n)
+{
+  int sum = 0;
+  for (unsigned int i = 0; i < n; ++i)
+    sum += values[i];
+  return sum;
+}
+
+void test12()
+{
+  std::cout << "*** TEST ITERATORI COSTANTI E DATA ***" << std::endl;
+
+  SortedArray<int, AscendingOrd, Equalz> arr;
+  for (int i = 9; i >= 0; --i)
+    arr.insert(i);
+  const SortedArray<int, AscendingOrd, Equalz> &c = arr;
+
+  int expected = 0;
+  for (auto it = c.cbegin(); it != c.cend(); ++it)
+    assert(*it == expected++);
+  expected = 9;
+  for (auto it = c.rbegin(); it != c.rend(); ++it)
+    assert(*it == expected--);
+
+  auto it = c.begin();
+  assert(it[3] == 3);
+  assert(*(2 + it) == 2);
+  assert(c.end() - c.begin() == 10);
+
+  // accesso diretto al buffer e algoritmi standard su puntatori
+  assert(c.data() == &c[0]);
+  assert(sum_of(c.data(), c.size()) == 45);
+  assert(*std::lower_bound(c.begin(), c.end(), 7) == 7);
+
+#if __cplusplus >= 202002L
+  static_assert(std::contiguous_iterator<SortedArray<int, AscendingOrd, Equalz>::const_iterator>);
+  std::span<const int> view = c;
+  assert(view.size() == 10 && view.data() == c.data());
+  assert(std::ranges::binary_search(c, 4));
+  assert(*std::ranges::max_element(c) == 9);
+#endif
+}
+
+void test13()
+{
+  std::cout << "*** TEST ARRAY ESTERNO E INDICI A 64 BIT ***" << std::endl;
+
+  // npos e size_type a 64 bit sull'array in memoria
+  SortedArray<int, AscendingOrd, Equalz> small;
+  assert(sizeof(small.size()) == sizeof(std::size_t));
+  assert(small.searchsorted(3) == 0 && !small.find(3));
+
+  // 10000 interi in ordine sparso, run da 1000 e blocchi da 64
+  std::vector<int> input;
+  for (int i = 0; i < 10000; ++i)
+    input.push_back((i * 7919) % 10000 / 2); // ogni valore 0..4999 due volte
+
+  const char *path = "sortedarray_external.tmp";
+  {
+    ExternalSortedArray<int, AscendingOrd> ext(path, input.begin(), input.end(), 1000, 64);
+    assert(ext.size() == 10000);
+    for (std::size_t i = 1; i < ext.size(); ++i)
+      assert(ext[i - 1] <= ext[i]);
+
+    assert(ext.lower_bound(0) == 0);
+    assert(ext.lower_bound(2500) == 5000);
+    assert(ext.lower_bound(5000) == 10000);
+    assert(ext.find(4999) && !ext.find(5000) && !ext.find(-1));
+
+    // una ricerca legge al massimo un blocco
+    std::size_t reads = ext.block_reads();
+    ext.lower_bound(1234);
+    assert(ext.block_reads() - reads <= 1);
+    assert(ext.fence_bytes() == (10000 + 63) / 64 * sizeof(int));
+  }
+  {
+    // riapertura del file ordinato gia' scritto
+    ExternalSortedArray<int, AscendingOrd> ext(path, 64);
+    assert(ext.size() == 10000);
+    assert(ext.lower_bound(1000) == 2000 && ext.find(1000));
+  }
+  {
+    // 10 run con fan_in 2: tre passate intermedie prima di quella finale
+    ExternalSortedArray<int, AscendingOrd> ext(path, input.begin(), input.end(), 1000, 64, 2);
+    assert(ext.size() == 10000);
+    for (std::size_t i = 1; i < ext.size(); ++i)
+      assert(ext[i - 1] <= ext[i]);
+    assert(ext.lower_bound(2500) == 5000 && ext.find(4999));
+    for (int r = 0; r < 30; ++r)
+      assert(!std::ifstream((std::string(path) + ".run" + std::to_string(r)).c_str()));
+
+    // letture da piu' thread: file e cache condivisi sono sotto lock
+    bool ok[4] = {true, true, true, true};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t)
+      readers.push_back(std::thread([&ext, &ok, t]()
+                                    {
+                                      for (int k = t; k < 5000; k += 4)
+                                        if (ext.lower_bound(k) != 2 * static_cast<std::size_t>(k) ||
+                                            ext[2 * k + 1] != k || !ext.find(k))
+                                          ok[t] = false;
+                                    }));
+    for (int t = 0; t < 4; ++t)
+      readers[t].join();
+    assert(ok[0] && ok[1] && ok[2] && ok[3]);
+  }
+  std::remove(path);
+
+  // un file che non si puo' creare fa lanciare il costruttore
+  bool thrown = false;
+  try
+  {
+    ExternalSortedArray<int, AscendingOrd> ext("no_such_dir/external.tmp", input.begin(), input.end(), 1000, 64);
+  }
+  catch (const std::runtime_error &)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+
+  // anche la riapertura di un file che non c'e'
+  thrown = false;
+  try
+  {
+    ExternalSortedArray<int, AscendingOrd> ext(path, 64);
+  }
+  catch (const std::runtime_error &)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+void test14()
+{
+  std::cout << "*** TEST INSERIMENTI E RICERCHE CON HINT ***" << std::endl;
+
+  // serie temporale: inserimenti in coda con hint = end()
+  SortedArray<int, AscendingOrd, Equalz> ts;
+  for (int i = 0; i < 1000; ++i)
+    ts.insert(ts.end(), i);
+  assert(ts.size() == 1000);
+  assert(ts.capacity() >= ts.size() && ts.capacity() <= 2 * ts.size());
+  for (std::size_t i = 0; i < ts.size(); ++i)
+    assert(ts[i] == static_cast<int>(i));
+
+  // un hint sbagliato non cambia il risultato
+  auto it = ts.insert(ts.begin(), 500);
+  assert(*it == 500 && it - ts.begin() == 500 && ts.count(500) == 2);
+  ts.insert(ts[3]); // elemento dello stesso array
+  assert(ts.count(3) == 2 && ts[4] == 3);
+
+  for (int key = -5; key < 1010; key += 7)
+  {
+    auto expected = std::lower_bound(ts.begin(), ts.end(), key);
+    assert(ts.lower_bound(ts.begin() + 600, key) == expected);
+    assert(ts.lower_bound(ts.end(), key) == expected);
+  }
+
+  // la copia condivisa non vede gli inserimenti in place
+  SortedArray<int, AscendingOrd, Equalz> snapshot(ts);
+  ts.insert(ts.end(), 2000);
+  assert(snapshot.size() == 1002 && ts.size() == 1003);
+
+  // cursore su un flusso di chiavi crescenti
+  SortedArray<int, AscendingOrd, Equalz>::cursor cur(ts);
+  assert(cur.seek(10) == 11);
+  assert(cur.seek(100) == 101);
+  assert(cur.seek(-1) == 0);
+  assert(cur.insert(5000) && cur.position() == ts.size());
+
+#ifdef SORTEDARRAY_STATS
+  // ricerche vicine all'hint costano poche sonde
+  ts.reset_stats();
+  for (int i = 3000; i < 3100; ++i)
+    cur.insert(i);
+  assert(ts.stats().max_probes <= 4);
+#endif
+
+  // con unique_policy l'hint restituisce l'elemento gia' presente
+  SortedArray<int, AscendingOrd, Equalz, unique_policy> uniq;
+  for (int i = 0; i < 10; ++i)
+    uniq.insert(uniq.end(), i * 2);
+  auto found = uniq.insert(uniq.end(), 4);
+  assert(*found == 4 && found - uniq.begin() == 2 && uniq.size() == 10);
+  SortedArray<int, AscendingOrd, Equalz, unique_policy>::cursor ucur(uniq);
+  assert(!ucur.insert(6) && ucur.insert(7) && uniq.size() == 11);
+
+  uniq.reserve(100);
+  assert(uniq.capacity() == 100 && uniq.size() == 11 && uniq[4] == 7);
+}
+
+void test15()
+{
+  std::cout << "*** TEST TOP-K CON LIMITE ***" << std::endl;
+
+  // i 5 valori maggiori di un flusso
+  SortedArray<int, AscendingOrd, Equalz> top;
+  top.set_bound(5);
+  assert(top.bound() == 5 && top.capacity() == 5);
+  const int *buffer = nullptr;
+  int stream[] = {7, 3, 9, 1, 12, 5, 8, 20, 2, 11};
+  for (int x : stream)
+  {
+    top.insert(x);
+    if (top.size() == 5 && buffer == nullptr)
+      buffer = top.data();
+  }
+  assert(top.size() == 5);
+  int expected[] = {8, 9, 11, 12, 20};
+  assert(std::equal(top.begin(), top.end(), expected));
+  // nessuna riallocazione dopo il riempimento
+  assert(top.data() == buffer && top.capacity() == 5);
+
+  // peggiore o uguale al minimo: rifiutato
+  assert(!top.insert(8) && !top.insert(-1));
+  assert(top.insert(top.end(), 0) == top.end());
+  assert(top.insert(10) && top[0] == 9 && top[1] == 10);
+
+  // la copia condivisa non vede le espulsioni
+  SortedArray<int, AscendingOrd, Equalz> snapshot(top);
+  assert(top.insert(30) && top[0] == 10 && top[4] == 30);
+  assert(snapshot[0] == 9 && snapshot[4] == 20 && snapshot.bound() == 5);
+
+  // ridurre il limite toglie i minori, 0 lo rimuove
+  top.set_bound(2);
+  assert(top.size() == 2 && top[0] == 20 && top[1] == 30);
+  top.set_bound(0);
+  assert(top.insert(1) && top.size() == 3);
+
+  // con order_policy decrescente si tengono i minori
+  SortedArray<int, DescendingOrd, Equalz, unique_policy> smallest;
+  smallest.set_bound(3);
+  for (int i = 100; i > 0; --i)
+    smallest.insert(i % 50);
+  assert(smallest.size() == 3 && smallest[0] == 2 && smallest[2] == 0);
+}
+
+void test16()
+{
+  std::cout << "*** TEST RICERCHE CON CHIAVI ETEROGENEE ***" << std::endl;
+
+  SortedArray<Person, TransparentAgeOrder, TransparentAgeEqual> people;
+  people.insert(Person("John", 25));
+  people.insert(Person("Alice", 30));
+  people.insert(Person("Bob", 20));
+  people.insert(Person("Jane", 35));
+  people.insert(Person("Eve", 30));
+
+  // ricerca per eta' con un int, senza costruire un Person
+  assert(people.find(30) && !people.find(31));
+  assert(people.count(30) == 2);
+  assert(people.searchsorted(30) == 2 && people.searchsorted(100) == 5);
+  assert(people.range_count(21, 31) == 3);
+  assert(people.range_min(21, 31).age == 25);
+  assert(people.range_max(21, 31).age == 30);
+
+  assert(people.remove(20) == 0 && people.remove(20) == -1);
+  assert(people.size() == 4 && people[0].name == "John");
+
+  // la versione con T resta disponibile
+  assert(people.find(Person("Nobody", 35)));
+
+  // senza is_transparent la chiave viene convertita in T come prima
+  SortedArray<double, std::less<double>, std::equal_to<double>> values;
+  values.insert(1.5);
+  values.insert(2.5);
+  assert(values.find(2.5) && values.searchsorted(2) == 1);
+}
+
+struct PersonNameHash
+{
+  std::size_t operator()(const Person &p) const
+  {
+    return std::hash<std::string>()(p.name);
+  }
+};
+
+void test17()
+{
+  std::cout << "*** TEST FILTRO DI APPARTENENZA ***" << std::endl;
+
+  SortedArray<int, AscendingOrd, Equalz> even;
+  for (int i = 0; i < 2000; i += 2)
+    even.insert(even.end(), i);
+  even.enable_filter(0.01);
+
+  // nessun falso negativo, quasi tutti i dispari esclusi dal filtro
+  for (int i = 0; i < 2000; ++i)
+    assert(even.find(i) == (i % 2 == 0));
+  sortedarray_filter_stats fs = even.filter_stats();
+  assert(fs.passed == 1000 + fs.false_positives);
+  assert(fs.rejected + fs.false_positives == 1000);
+  assert(fs.false_positive_rate() < 0.05);
+  assert(even.filter_bytes() > 0);
+
+  // gli insert aggiornano il filtro; le rimozioni lo lasciano valido
+  even.insert(2001);
+  assert(even.find(2001) && even.count(2001) == 1);
+  assert(even.remove(10) == 0 && !even.find(10) && even.count(10) == 0);
+  assert(even.erase_range(100, 200) == 50 && !even.find(150) && even.find(200));
+  std::size_t bytes = even.filter_bytes();
+  assert(bytes > 0);
+  unsigned long long rejected = even.filter_stats().rejected;
+  for (int i = 1; i < 2000; i += 2)
+    assert(!even.find(i));
+  assert(even.filter_stats().rejected - rejected > 900);
+
+  // superate le chiavi previste il filtro viene ricostruito piu' grande
+  for (int i = 2003; i < 6003; i += 2)
+    even.insert(even.end(), i);
+  assert(even.filter_bytes() > bytes);
+  for (int i = 2001; i < 6003; ++i)
+    assert(even.find(i) == (i % 2 == 1));
+
+  // ricerche concorrenti: il filtro si legge soltanto, i contatori sono atomici
+  fs = even.filter_stats();
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; ++t)
+    readers.push_back(std::thread([&even]()
+                                  {
+                                    for (int i = 1; i < 2000; i += 2)
+                                      assert(even.count(i) == 0);
+                                  }));
+  for (std::size_t t = 0; t < readers.size(); ++t)
+    readers[t].join();
+  sortedarray_filter_stats after = even.filter_stats();
+  assert(after.passed + after.rejected == fs.passed + fs.rejected + 4000);
+
+  // copia e swap si portano dietro la configurazione
+  SortedArray<int, AscendingOrd, Equalz> copy(even);
+  assert(copy.find(2001) && !copy.find(3));
+  even.makeEmpty();
+  assert(!even.find(0));
+  even.disable_filter();
+  assert(even.filter_bytes() == 0);
+
+  // hash personalizzato, coerente con NameEqualPolicy
+  SortedArray<Person, AgeOrderPolicy, NameEqualPolicy> people;
+  people.enable_filter<PersonNameHash>();
+  people.insert(Person("John", 25));
+  people.insert(Person("Alice", 30));
+  assert(people.find(Person("Alice", 30)) && !people.find(Person("Bob", 30)));
+}
+
+void test18()
+{
+  std::cout << "*** TEST MERGE JOIN ***" << std::endl;
+
+  SortedArray<Person, AgeOrderPolicy, NameEqualPolicy> people;
+  people.insert(Person("John", 25));
+  people.insert(Person("Alice", 30));
+  people.insert(Person("Bob", 20));
+  people.insert(Person("Jane", 35));
+  people.insert(Person("Eve", 30));
+
+  SortedArray<int, AscendingOrd, Equalz> ages;
+  int age_list[] = {18, 30, 30, 35, 40};
+  for (int a : age_list)
+    ages.insert(a);
+
+  AgeKey person_age;
+  auto self = [](int x)
+  { return x; };
+
+  // inner: gruppi duplicati danno il prodotto cartesiano (2 x 2 + 1)
+  int pairs = 0;
+  assert(merge_join(people, ages, person_age, self, [&](const Person &p, int a)
+                    { assert(p.age == a); ++pairs; }) == 5);
+  assert(pairs == 5);
+
+  // semi: ogni persona con eta' presente, una sola volta
+  std::string names;
+  merge_semi_join(people, ages, person_age, self, [&](const Person &p)
+                  { names += p.name[0]; });
+  assert(names.size() == 3 && names.find('J') != std::string::npos);
+
+  // anti: persone senza corrispondenza
+  assert(merge_anti_join(people, ages, person_age, self, [](const Person &p)
+                         { assert(p.age == 20 || p.age == 25); }) == 2);
+
+  // array sbilanciati e piu' thread: stesso risultato del caso sequenziale
+  SortedArray<int, AscendingOrd, Equalz> big;
+  for (int i = 0; i < 20000; ++i)
+    big.insert(big.end(), i / 3);
+  SortedArray<int, AscendingOrd, Equalz> few;
+  int few_list[] = {-1, 7, 7, 4000, 6666, 9999};
+  for (int x : few_list)
+    few.insert(x);
+
+  std::atomic<long> sum(0);
+  auto add = [&](int x, int)
+  { sum += x; };
+  assert(merge_join(big, few, self, self, add) == 3 * 2 + 3 + 2); // 7 due volte, 6666 solo due volte in big
+  long sequential = sum;
+  sum = 0;
+  assert(merge_join(big, few, self, self, add, 4) == 11);
+  assert(sum == sequential);
+
+  std::atomic<long> missing(0);
+  assert(merge_anti_join(big, few, self, self, [&](int)
+                         { ++missing; }, 3) == 20000 - 8);
+  assert(missing == 20000 - 8);
+}
+
+void test19()
+{
+  std::cout << "*** TEST FINESTRA SCORREVOLE ***" << std::endl;
+
+  // indice temporale: si aggiunge in coda e si scarta il passato
+  SortedArray<int, AscendingOrd, Equalz> window;
+  for (int t = 0; t < 100; ++t)
+    window.insert(window.end(), t);
+  const int *first = window.data();
+  assert(window.trim_below(30) == 30);
+  assert(window.size() == 70 && window[0] == 30);
+  assert(window.data() == first + 30); // nessun elemento spostato
+  assert(window.trim_below(30) == 0);
+
+  // a regime il buffer non cresce: lo spazio in testa viene riusato
+  std::size_t capacity = window.capacity();
+  for (int t = 100; t < 10000; ++t)
+  {
+    window.insert(window.end(), t);
+    window.trim_below(t - 69);
+  }
+  assert(window.size() == 70 && window[0] == 9930 && window[69] == 9999);
+  assert(window.capacity() == capacity);
+  for (std::size_t i = 1; i < window.size(); ++i)
+    assert(window[i - 1] < window[i]);
+
+  // inserimenti in testa usano lo spazio in testa
+  window.trim_below(9990);
+  for (int t = 9989; t > 9900; --t)
+    window.insert(window.begin(), t);
+  assert(window.size() == 99 && window[0] == 9901 && window[98] == 9999);
+
+  assert(window.trim_above(9949) == 50);
+  assert(window.size() == 49 && window[48] == 9949);
+  assert(window.remove(9901) == 0 && window[0] == 9902);
+
+  // la copia condivisa non viene toccata dai tagli
+  SortedArray<int, AscendingOrd, Equalz> snapshot(window);
+  window.trim_below(9940);
+  window.trim_above(9945);
+  window.insert(1);
+  assert(snapshot.size() == 48 && snapshot[0] == 9902 && snapshot[47] == 9949);
+  assert(window.size() == 7 && window[0] == 1 && window[6] == 9945);
+
+  assert(window.trim_below(100000) == 7 && window.size() == 0);
+
+  // con reserve() e set_bound() la capacita' non cambia, qualunque sia
+  // il lato libero del buffer
+  SortedArray<int, AscendingOrd, Equalz> reserved;
+  reserved.reserve(100);
+  for (int i = 0; i < 90; ++i)
+    reserved.insert(reserved.end(), i * 10);
+  reserved.insert(15);   // davanti
+  reserved.insert(455);  // in mezzo
+  reserved.insert(-5);   // in testa
+  assert(reserved.size() == 93 && reserved.capacity() == 100);
+  reserved.trim_below(100);
+  assert(reserved.size() == 81);
+  for (int i = 0; i < 19; ++i)
+    reserved.insert(i * 10 + 101); // spazio libero solo in testa
+  assert(reserved.size() == 100 && reserved.capacity() == 100);
+  for (std::size_t i = 1; i < reserved.size(); ++i)
+    assert(reserved[i - 1] <= reserved[i]);
+
+  SortedArray<int, AscendingOrd, Equalz> bounded;
+  bounded.set_bound(100);
+  for (int i = 0; i < 99; ++i)
+    bounded.insert(bounded.end(), i * 10);
+  bounded.insert(15);
+  assert(bounded.size() == 100 && bounded.capacity() == 100);
+  bounded.insert(455); // pieno: espelle il minimo
+  bounded.insert(5);   // rifiutato
+  assert(bounded.size() == 100 && bounded.capacity() == 100);
+  assert(bounded[0] == 10 && bounded[99] == 980);
+}
+
 int main(int argc, char const *argv[])
 {
   test2();
   test1();
   test0();
   test3();
+  test4();
+  test5();
+  test6();
+  test7();
+  test8();
+  test9();
+  test10();
+  test11();
+  test12();
+  test13();
+  test14();
+  test15();
+  test16();
+  test17();
+  test18();
+  test19();
 }
\ No newline at end of file
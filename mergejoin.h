@@ -0,0 +1,269 @@
+#ifndef MergeJoin_H
+#define MergeJoin_H
+
+#include <cstddef>    // std::size_t
+#include <functional> // std::less
+#include <thread>     // std::thread
+#include <vector>     // std::vector
+#include <exception>  // std::exception_ptr
+
+/**
+  @file mergejoin.h
+  @brief Merge join tra array ordinati per chiave
+
+  Le funzioni lavorano su qualunque contenitore con size() e operator[]
+  (SortedArray, KeyedSortedArray, std::vector, ...), anche di tipi
+  diversi: key_a e key_b estraggono la chiave comune dagli elementi.
+  Entrambi gli array devono essere ordinati per chiave crescente secondo
+  less (di default operator< sulle chiavi).
+
+  Ogni array viene percorso una volta sola, O(n + m); quando le chiavi di
+  un lato non trovano corrispondenza si avanza con una ricerca
+  esponenziale, quindi se un array e' molto piu' piccolo dell'altro il
+  costo scende a O(m log(n / m)). Gruppi di chiavi duplicate danno il
+  prodotto cartesiano (inner) o una chiamata per elemento (semi, anti).
+
+  Con threads > 1 l'array a viene diviso in intervalli di chiavi
+  disgiunti, elaborati in parallelo: callback deve poter essere chiamata
+  da piu' thread contemporaneamente e l'ordine delle chiamate non e' piu'
+  quello delle chiavi. Se una callback lancia, l'eccezione viene
+  rilanciata dopo aver atteso tutti i thread.
+*/
+
+/// Implementazione comune delle varianti di merge join
+template <typename A, typename B, typename KA, typename KB, typename L>
+class MergeJoin
+{
+public:
+  typedef std::size_t size_type;
+
+  enum join_kind
+  {
+    join_inner,
+    join_semi,
+    join_anti
+  };
+
+  MergeJoin(const A &a, const B &b, KA key_a, KB key_b, L less)
+      : _a(a), _b(b), _key_a(key_a), _key_b(key_b), _less(less)
+  {
+  }
+
+  // esegue il join, eventualmente diviso su piu' thread
+  template <join_kind Kind, typename F>
+  size_type run(F &callback, unsigned threads) const
+  {
+    size_type n = _a.size();
+    if (threads <= 1 || n < 2 * threads)
+      return join<Kind>(callback, 0, n, 0, _b.size());
+
+    // confini tra gli intervalli, spostati all'inizio di un gruppo di chiavi
+    std::vector<size_type> cuts;
+    cuts.push_back(0);
+    for (unsigned t = 1; t < threads; ++t)
+    {
+      size_type cut = n / threads * t;
+      if (cut <= cuts.back())
+        continue;
+      cut = skip(_a, _key_a, cut, n, _key_a(_a[cut - 1]), true);
+      if (cut > cuts.back() && cut < n)
+        cuts.push_back(cut);
+    }
+    cuts.push_back(n);
+
+    size_type parts = cuts.size() - 1;
+    std::vector<size_type> found(parts, 0);
+    std::vector<std::exception_ptr> errors(parts);
+    std::vector<std::thread> workers;
+
+    auto work = [&](size_type p)
+    {
+      try
+      {
+        size_type b_lo = (cuts[p] == 0) ? 0 : skip(_b, _key_b, 0, _b.size(), _key_a(_a[cuts[p]]), false);
+        size_type b_hi = (cuts[p + 1] == n) ? _b.size() : skip(_b, _key_b, b_lo, _b.size(), _key_a(_a[cuts[p + 1]]), false);
+        found[p] = join<Kind>(callback, cuts[p], cuts[p + 1], b_lo, b_hi);
+      }
+      catch (...)
+      {
+        errors[p] = std::current_exception();
+      }
+    };
+
+    try
+    {
+      for (size_type p = 1; p < parts; ++p)
+        workers.push_back(std::thread(work, p));
+    }
+    catch (...)
+    {
+      for (size_type w = 0; w < workers.size(); ++w)
+        workers[w].join();
+      throw;
+    }
+    work(0);
+    for (size_type w = 0; w < workers.size(); ++w)
+      workers[w].join();
+
+    size_type total = 0;
+    for (size_type p = 0; p < parts; ++p)
+    {
+      if (errors[p])
+        std::rethrow_exception(errors[p]);
+      total += found[p];
+    }
+    return total;
+  }
+
+private:
+  /*
+    Primo indice in [from, to) la cui chiave non e' minore di key
+    (after = false) o e' maggiore di key (after = true). Ricerca
+    esponenziale a partire da from, poi bisezione.
+  */
+  template <typename C, typename K, typename Key>
+  size_type skip(const C &c, const K &key_of, size_type from, size_type to,
+                 const Key &key, bool after) const
+  {
+    size_type under = from;
+    size_type upper = to;
+    size_type step = 1;
+    while (under < to)
+    {
+      size_type probe = (to - under > step) ? under + step - 1 : to - 1;
+      if (!before(key_of(c[probe]), key, after))
+      {
+        upper = probe;
+        break;
+      }
+      under = probe + 1;
+      step *= 2;
+    }
+    while (under < upper)
+    {
+      size_type mid = under + (upper - under) / 2;
+      if (before(key_of(c[mid]), key, after))
+        under = mid + 1;
+      else
+        upper = mid;
+    }
+    return under;
+  }
+
+  // x precede la posizione cercata: x < key, oppure x <= key se after
+  template <typename X, typename Key>
+  bool before(const X &x, const Key &key, bool after) const
+  {
+    return after ? !_less(key, x) : _less(x, key);
+  }
+
+  // join di a[a_lo, a_hi) con b[b_lo, b_hi)
+  template <join_kind Kind, typename F>
+  size_type join(F &callback, size_type i, size_type a_hi, size_type j, size_type b_hi) const
+  {
+    size_type calls = 0;
+    while (i < a_hi && j < b_hi)
+    {
+      auto ka = _key_a(_a[i]);
+      auto kb = _key_b(_b[j]);
+      if (_less(ka, kb))
+      {
+        size_type next = skip(_a, _key_a, i + 1, a_hi, kb, false);
+        if constexpr (Kind == join_anti)
+          for (; i < next; ++i, ++calls)
+            callback(_a[i]);
+        i = next;
+      }
+      else if (_less(kb, ka))
+      {
+        j = skip(_b, _key_b, j + 1, b_hi, ka, false);
+      }
+      else
+      {
+        // gruppi di chiavi uguali sui due lati
+        size_type i_end = skip(_a, _key_a, i + 1, a_hi, ka, true);
+        size_type j_end = skip(_b, _key_b, j + 1, b_hi, ka, true);
+        if constexpr (Kind == join_inner)
+        {
+          for (size_type x = i; x < i_end; ++x)
+            for (size_type y = j; y < j_end; ++y, ++calls)
+              callback(_a[x], _b[y]);
+        }
+        else if constexpr (Kind == join_semi)
+        {
+          for (size_type x = i; x < i_end; ++x, ++calls)
+            callback(_a[x]);
+        }
+        i = i_end;
+        j = j_end;
+      }
+    }
+    if constexpr (Kind == join_anti)
+      for (; i < a_hi; ++i, ++calls)
+        callback(_a[i]);
+    return calls;
+  }
+
+  const A &_a;
+  const B &_b;
+  KA _key_a;
+  KB _key_b;
+  L _less;
+};
+
+/**
+  @brief Inner join: callback(x, y) per ogni coppia con chiavi uguali
+
+  @param a primo array, ordinato per key_a
+  @param b secondo array, ordinato per key_b
+  @param key_a estrae la chiave da un elemento di a
+  @param key_b estrae la chiave da un elemento di b
+  @param callback chiamata con (elemento di a, elemento di b)
+  @param threads numero di thread da usare
+  @param less ordinamento delle chiavi
+
+  @return numero di chiamate a callback
+*/
+template <typename A, typename B, typename KA, typename KB, typename F,
+          typename L = std::less<>>
+std::size_t merge_join(const A &a, const B &b, KA key_a, KB key_b, F callback,
+                       unsigned threads = 1, L less = L())
+{
+  MergeJoin<A, B, KA, KB, L> join(a, b, key_a, key_b, less);
+  return join.template run<MergeJoin<A, B, KA, KB, L>::join_inner>(callback, threads);
+}
+
+/**
+  @brief Left semi join: callback(x) per ogni x di a con almeno una
+  corrispondenza in b
+
+  Parametri come @ref merge_join(); callback riceve solo l'elemento di a.
+
+  @return numero di chiamate a callback
+*/
+template <typename A, typename B, typename KA, typename KB, typename F,
+          typename L = std::less<>>
+std::size_t merge_semi_join(const A &a, const B &b, KA key_a, KB key_b, F callback,
+                            unsigned threads = 1, L less = L())
+{
+  MergeJoin<A, B, KA, KB, L> join(a, b, key_a, key_b, less);
+  return join.template run<MergeJoin<A, B, KA, KB, L>::join_semi>(callback, threads);
+}
+
+/**
+  @brief Anti join: callback(x) per ogni x di a senza corrispondenze in b
+
+  Parametri come @ref merge_join(); callback riceve solo l'elemento di a.
+
+  @return numero di chiamate a callback
+*/
+template <typename A, typename B, typename KA, typename KB, typename F,
+          typename L = std::less<>>
+std::size_t merge_anti_join(const A &a, const B &b, KA key_a, KB key_b, F callback,
+                            unsigned threads = 1, L less = L())
+{
+  MergeJoin<A, B, KA, KB, L> join(a, b, key_a, key_b, less);
+  return join.template run<MergeJoin<A, B, KA, KB, L>::join_anti>(callback, threads);
+}
+
+#endif
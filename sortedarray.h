@@ -4,18 +4,148 @@
 #include <ostream> // std::ostream
 #include <cassert>
 #include <iterator> // std::forward_iterator_tag
-#include <cstddef>  // std::ptrdiff_t
+#include <cstddef>  // std::ptrdiff_t, std::size_t
+#include <cmath>    // std::sqrt
+#include <type_traits> // std::is_arithmetic
+#include <utility>  // std::swap
+#include <atomic>   // std::atomic
+#include <mutex>    // std::mutex, std::lock_guard
+#include <functional> // std::hash
+#include "learnedindex.h"
+#include "bloomfilter.h"
 
 /**
   @file SortedArray.h
   @brief Dichiarazione della classe SortedArray
 */
 
+/*
+  Compilando con SORTEDARRAY_STATS definita ogni SortedArray tiene dei
+  contatori di profilazione (vedi @ref sortedarray_stats); altrimenti le
+  istruzioni che li aggiornano spariscono e non costano nulla.
+*/
+#ifdef SORTEDARRAY_STATS
+#define SORTEDARRAY_STAT(expr) (expr)
+#else
+#define SORTEDARRAY_STAT(expr) ((void)0)
+#endif
+
+/**
+  @brief Contatori di profilazione di un SortedArray
+
+  Aggiornati solo se si compila con SORTEDARRAY_STATS, altrimenti
+  restano a zero. Si leggono con SortedArray::stats().
+*/
+struct sortedarray_stats
+{
+  unsigned long long allocations;     ///< array di elementi allocati
+  unsigned long long bytes_moved;     ///< byte copiati da un array all'altro
+  unsigned long long comparisons;     ///< chiamate a order_policy e equal_policy
+  unsigned long long searches;        ///< ricerche di posizione
+  unsigned long long probes;          ///< elementi confrontati dalle ricerche
+  unsigned long long max_probes;      ///< sonde della ricerca piu' lunga
+  unsigned long long inserts;         ///< inserimenti eseguiti
+  unsigned long long insert_shift;    ///< elementi spostati dagli inserimenti
+  unsigned long long filter_tested;   ///< elementi valutati da filter
+  unsigned long long filter_selected; ///< elementi che hanno superato il filtro
+
+  sortedarray_stats()
+  {
+    reset();
+  }
+
+  /// Azzera tutti i contatori
+  void reset()
+  {
+    allocations = bytes_moved = comparisons = 0;
+    searches = probes = max_probes = 0;
+    inserts = insert_shift = 0;
+    filter_tested = filter_selected = 0;
+  }
+
+  /// Numero medio di sonde per ricerca
+  double mean_probes() const
+  {
+    return searches ? static_cast<double>(probes) / searches : 0;
+  }
+
+  /// Frazione di elementi che hanno superato il filtro
+  double filter_selectivity() const
+  {
+    return filter_tested ? static_cast<double>(filter_selected) / filter_tested : 0;
+  }
+};
+
+/**
+  @brief Contatori del filtro di appartenenza di un SortedArray
+
+  Sempre attivi quando il filtro e' acceso (vedi
+  SortedArray::enable_filter()); SortedArray::filter_stats() ne restituisce
+  una copia.
+*/
+struct sortedarray_filter_stats
+{
+  unsigned long long rejected;        ///< ricerche escluse dal filtro
+  unsigned long long passed;          ///< ricerche passate al filtro
+  unsigned long long false_positives; ///< passate ma senza risultato
+
+  sortedarray_filter_stats()
+  {
+    reset();
+  }
+
+  /// Azzera tutti i contatori
+  void reset()
+  {
+    rejected = passed = false_positives = 0;
+  }
+
+  /// Frazione delle chiavi assenti che il filtro non ha escluso
+  double false_positive_rate() const
+  {
+    unsigned long long absent = rejected + false_positives;
+    return absent ? static_cast<double>(false_positives) / absent : 0;
+  }
+};
+
+/**
+  @brief Proiezione identita', default di SortedArray::range_sum()
+*/
+struct sortedarray_identity
+{
+  template <typename U>
+  const U &operator()(const U &x) const
+  {
+    return x;
+  }
+};
+
+/**
+  @brief Politiche sui duplicati di SortedArray
+
+  - multiset_policy: insert aggiunge sempre una copia (default)
+  - unique_policy: insert rifiuta un elemento gia' presente secondo
+    equal_policy, in O(log n)
+  - run_length_policy: gli elementi uguali sono memorizzati una sola volta
+    insieme al numero di ripetizioni
+*/
+struct multiset_policy
+{
+};
+
+struct unique_policy
+{
+};
+
+struct run_length_policy
+{
+};
+
 /**
   @brief Classe SortedArray
 
   Classe che vuole rappresentare un array dinamico ordinato.
-  Classe Template, con 3 parametri Template
+  Classe Template, con 4 parametri Template
   
   Supporta iteratore random access
 
@@ -23,17 +153,48 @@
   @param T Tipo dei dati da inserire nel container
   @param P Policy per il confronto e ordinamento degli elementi
   @param Q Policy di uguaglianza
-
-
+  @param D Politica sui duplicati, multiset_policy o unique_policy;
+           run_length_policy ha una specializzazione a parte
+
+  Thread safety: come per i contenitori standard, piu' thread possono
+  chiamare insieme i metodi const sullo stesso oggetto (le strutture
+  costruite alla prima ricerca sono protette da un mutex); ogni modifica
+  richiede accesso esclusivo. Con SORTEDARRAY_STATS i contatori di
+  @ref stats() non sono sincronizzati.
 */
-template <typename T, typename P, typename Q>
+template <typename T, typename P, typename Q, typename D = multiset_policy>
 class SortedArray
 {
+  static_assert(std::is_same<D, multiset_policy>::value ||
+                    std::is_same<D, unique_policy>::value,
+                "D deve essere multiset_policy o unique_policy");
+
 public:
   typedef T value_type;           /// Tipo del dato dell'array
-  typedef unsigned int size_type; /// Tipo del dato size
+  typedef std::size_t size_type;  /// Tipo del dato size, a 64 bit
   typedef P order_policy;
   typedef Q equal_policy;
+  typedef D duplicate_policy;
+
+  /**
+    @brief Strategie di ricerca usate da searchsorted
+
+    - search_binary: ricerca binaria classica, ~log2(n) sonde
+    - search_interpolation: ricerca per interpolazione con guardia e
+      ricaduta sulla bisezione, O(log log n) sonde attese su chiavi
+      distribuite uniformemente e O(log n) nel caso peggiore
+    - search_adaptive: campiona la distribuzione delle chiavi e sceglie
+      da solo tra le due precedenti
+
+    Le ultime due hanno effetto solo se T e' un tipo aritmetico,
+    altrimenti si usa sempre la ricerca binaria.
+  */
+  enum search_mode
+  {
+    search_binary,
+    search_interpolation,
+    search_adaptive
+  };
 
   /**
     @brief Costruttore di default
@@ -47,9 +208,6 @@ public:
 
   SortedArray() : _array(nullptr), _size(0)
   {
-#ifndef NDEBUG
-    std::cout << "SortedArray::SortedArray()" << std::endl;
-#endif
   }
 
   /**
@@ -62,10 +220,10 @@ public:
   */
   ~SortedArray()
   {
+    _filter_hash = nullptr; // niente ricostruzione del filtro in makeEmpty
     this->makeEmpty();
-#ifndef NDEBUG
-    std::cout << "SortedArray::~SortedArray()" << std::endl;
-#endif
+    delete _learned;
+    delete _filter;
   }
   // Other member functions
 
@@ -73,36 +231,33 @@ public:
     @brief Copy Constructor
 
     Costruttore di copia. Serve a creare un oggetto come copia di un
-    altro oggetto. I due oggetti devono essere indipendenti.
+    altro oggetto. I due oggetti sono indipendenti dal punto di vista
+    logico, ma condividono il buffer (copy-on-write) finche' uno dei due
+    non viene modificato: la copia costa O(1).
+
+    Il contatore dei riferimenti e' atomico, quindi copie condivise
+    possono essere lette e distrutte da thread diversi.
 
     @param other SortedArray sorgente da copiare
 
-    @post _array != nullptr
+    @post _array = other._array
     @post _size = other._size
   */
-  SortedArray(const SortedArray<value_type,
-                                order_policy,
-                                equal_policy> &other)
-      : _array(nullptr), _size(0)
+  SortedArray(const SortedArray &other)
+      : _array(other._array), _size(other._size), _refs(other._refs),
+        _buffer(other._buffer), _capacity(other._capacity), _bound(other._bound), _search_mode(other._search_mode),
+        _learned_epsilon(other._learned_epsilon), _filter_fpr(other._filter_fpr),
+        _filter_hash(other._filter_hash)
   {
-
-    _array = new value_type[other._size];
-
-    _size = other._size;
-
-    try
+    if (other._filter_ready)
     {
-      for (size_type i = 0; i < _size; ++i)
-        _array[i] = other._array[i];
-    }
-    catch (...)
-    {
-      makeEmpty();
-      throw;
+      _filter = new BlockedBloomFilter(*other._filter);
+      _filter_keys = other._filter_keys;
+      _filter_stale = other._filter_stale;
+      _filter_ready = true;
     }
-#ifndef NDEBUG
-    std::cout << "SortedArray::SortedArray(const SortedArray&)" << std::endl;
-#endif
+    if (_refs != nullptr)
+      _refs->fetch_add(1, std::memory_order_relaxed);
   }
 
 /**
@@ -134,9 +289,6 @@ public:
       }
       ++begin;
     }
-#ifndef NDEBUG
-    std::cout << "SortedArray::SortedArray(Iter begin, Iter end)" << std::endl;
-#endif
   }
 /**
     @brief Costruttore da altro generico Sorted Array.
@@ -153,8 +305,8 @@ public:
     @ref insert()
   */
 
-  template <typename U, typename R, typename S>
-  SortedArray(const SortedArray<U, R, S> &other) : _array(nullptr), _size(0)
+  template <typename U, typename R, typename S, typename E>
+  SortedArray(const SortedArray<U, R, S, E> &other) : _array(nullptr), _size(0)
   {
     try
     {
@@ -167,10 +319,6 @@ public:
       makeEmpty();
       throw;
     }
-#ifndef NDEBUG
-    std::cout << "SortedArray::SortedArray(const SortedArray<U, R, S> &other)"
-              << std::endl;
-#endif
   }
 
   /**
@@ -188,18 +336,13 @@ public:
     @post _SortedArray != nullptr
     @post _size = other._size
   */
-  SortedArray &operator=(const SortedArray<value_type,
-                                           order_policy,
-                                           equal_policy> &other)
+  SortedArray &operator=(const SortedArray &other)
   {
     if (this != &other)
     {
       SortedArray tmp(other);
       this->swap(tmp);
     }
-#ifndef NDEBUG
-    std::cout << "SortedArray::operator=(const SortedArray &)" << std::endl;
-#endif
     return *this;
   }
 
@@ -208,83 +351,43 @@ public:
     
     Inserimento di un elemento nel SortedArray in posizione ordinata
 
+    Con unique_policy l'elemento non viene inserito se e' gia' presente
+    secondo equal_policy.
+
     @param item reference di elemento di tipo del SortedArray 
 
+    Con un limite impostato da @ref set_bound() e l'array pieno, un
+    elemento non migliore del minimo viene rifiutato in O(1); altrimenti
+    prende il posto del minimo.
+
+    @return true se l'elemento e' stato inserito
+
     @post _size++  
   */
 
-  void insert(const value_type &item)
+  bool insert(const value_type &item)
   {
-    value_type *new_array = new value_type[_size + 1];
-
-    int index = searchsorted(item);
-    // get_insert_index
-
-    if (_array == nullptr)
-    {
-      try
-      {
-        new_array[0] = item;
-      }
-      catch (...)
-      {
-        delete[] new_array;
-        throw;
-      }
-      std::swap(_array, new_array);
-      _size = 1;
-      return;
-    }
+    if (rejected_by_bound(item))
+      return false;
 
-    // copy first part
-    for (int i = 0; i < index; ++i)
-    {
-      try
-      {
-       new_array[i] = _array[i];
-      }
-      catch (...)
-      {
-        delete[] new_array;
-        throw;
-      }
-    }
+    SORTEDARRAY_STAT(begin_search());
+    size_type index = search_index(item);
+    SORTEDARRAY_STAT(end_search());
 
-    // insert
-    try
-    {
-      new_array[index] = item;
-    }
-    catch (...)
-    {
-      delete[] new_array;
-      throw;
-    }
+    if (std::is_same<duplicate_policy, unique_policy>::value &&
+        match_from(item, index) != npos)
+      return false;
 
-    // copy second part
-    for (int i = index; i < _size; i++)
-    {
-      try
-      {
-        new_array[i + 1] = _array[i];
-      }
-      catch (...)
-      {
-        delete[] new_array;
-        throw;
-      }
-    }
-    
-    std::swap(new_array, _array);
-    delete[] new_array;
-    _size += 1;
-    return;
+    place(index, item);
+    return true;
   }
 
  /**
     @brief Rimozione di un elemento
     
-    Rimozione di un elemento nel SortedArray in posizione ordinata, non fa niente se non lo trova
+    Rimozione di un elemento nel SortedArray in posizione ordinata, non fa niente se non lo trova.
+    Gli elementi successivi vengono spostati indietro di una posizione,
+    senza riallocare l'array.
 
     @param item reference di elemento di tipo del SortedArray 
     @return 0 if manages to remove 
@@ -294,427 +397,3546 @@ public:
   int remove(const value_type &item)
   {
     // get_insert_index
-    int index = get_index_of(item);
+    size_type index = get_index_of(item);
 
-    if(index == -1){
+    if(index == npos){
       // I chose -1 as error code
       return -1;
       }
 
-    value_type *new_array = nullptr;
+    erase_positions(index, index + 1);
+    return 0;
+  }
 
-    if (_size == 1)
-    {
-      assert(index == 0);
-      makeEmpty();
-      return 0;
-    }
+ /**
+    @brief Rimozione di un elemento cercato per chiave
 
-    new_array = new value_type[_size - 1];
+    Come @ref remove(const value_type &), ma con una chiave di tipo K
+    qualunque. Disponibile solo se order_policy e equal_policy dichiarano
+    is_transparent e confrontano K con T in entrambi i versi, come in
+    std::set: non serve costruire un T solo per cercarlo.
 
-    // copy first part
-    for (int i = 0; i < index; ++i)
-    {
-      try
-      {
-        new_array[i] = _array[i];
-      }
-      catch (...)
-      {
-        delete[] new_array;
-        throw;
-      }
-    }
+    @param key chiave dell'elemento da rimuovere
 
-    // copy second part skipping index
-    for (int i = index; i < _size - 1; i++)
-    {
-      try
-      {
-        new_array[i] = _array[i + 1];
-      }
-      catch (...)
-      {
-        delete[] new_array;
-        throw;
-      }
-    }
+    @return 0 se rimosso, -1 se non trovato
+  */
+  template <typename K, typename O = order_policy, typename E = equal_policy,
+            typename = typename O::is_transparent, typename = typename E::is_transparent>
+  int remove(const K &key)
+  {
+    size_type index = get_index_of(key);
+    if (index == npos)
+      return -1;
 
-    std::swap(new_array, _array);
-    delete[] new_array;
-    _size -= 1;
+    erase_positions(index, index + 1);
     return 0;
   }
 
  /**
-    @brief Searchsorted, ritorna indice al quale inserire per mantenere ordine
-    
-    @param item reference di elemento di tipo del SortedArray 
+    @brief Rimozione degli elementi con chiave in [lo, hi)
 
-    @return indice al quale si deve inserire 
-  
-*/
-  int searchsorted(const value_type& item) const
-{
-  order_policy ord;
-  int under = 0;
-  int upper = _size;
+    L'intervallo viene individuato con searchsorted.
 
-  while (under < upper)
-  {
-    int mid = (under + upper) / 2;
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
 
-    if (ord(_array[mid], item))
-      under = mid + 1;
-    else
-      upper = mid;
+    @return numero di elementi rimossi
+  */
+  size_type erase_range(const value_type &lo, const value_type &hi)
+  {
+    size_type first = searchsorted(lo);
+    size_type last = searchsorted(hi);
+    if (last <= first)
+      return 0;
+    return erase_positions(first, last);
   }
 
-  return under;
-}
-
-  // int searchsorted(const value_type &item) const
-  // {
-  //   order_policy ord;
-  //   if (_size == 0)
-  //   {
-  //     return 0;
-  //   }
-  //   for (int i = 0; i < _size; ++i)
-  //   {
-  //     if (ord(item, _array[i]))
-  //     {
-  //       return i;
-  //     }
-  //   }
-  //   return _size;
-  // }
-
  /**
-    @brief makeEmpty - svuota
-    
-    Funzione che svuota array e inizializza a zero la struttura dati occupandosi della memoria
+    @brief Rimozione di tutte le occorrenze di un elemento
 
+    Rimuove gli elementi uguali a item secondo equal_policy, cercandoli
+    tra quelli equivalenti per order_policy.
 
-    @post _size = 0
-    @post _array = nullptr  
+    @param item elemento da rimuovere
+
+    @return numero di elementi rimossi
   */
-  void makeEmpty()
+  size_type erase_all(const value_type &item)
   {
-    delete[] _array;
-    _array = nullptr;
-    _size = 0;
-    return;
+    equal_policy eq;
+    return compact(searchsorted(item), upper_index(item),
+                   [this, &eq, &item](const value_type &x)
+                   {
+                     SORTEDARRAY_STAT(++_stats.comparisons);
+                     return eq(item, x);
+                   });
   }
 
  /**
-    @brief find - ricerca un elemento se presente
-    
-    Inserimento di un elemento nel SortedArray in posizione ordinata
+    @brief Rimozione degli elementi che soddisfano un predicato
 
-    @param item reference di elemento di tipo del SortedArray 
+    Un solo passaggio sull'array, senza riallocare.
 
-    @return 1, trovato, 
-    @return 0, non trovato  
+    @param pred funtore booleano su value_type
+
+    @return numero di elementi rimossi
   */
-  bool find(const value_type &target) const
+  template <typename Pred>
+  size_type erase_if(Pred pred)
   {
-    return (get_index_of(target) != -1);
+    return compact(0, _size, pred);
   }
 
-/**
-    @brief Filter - filtra l'array e restituisce un altro SortedArray
-    
+ /**
+    @brief Rimozione degli elementi minori di key
 
-    @param filt Policy che vogliamo usare per filtrare l'array, una sua istanza confrontando un elemento di tipo value_type con l'operatore (), deve restituire un boolean
+    Pensato per finestre temporali: il prefisso da togliere viene
+    individuato con searchsorted e scartato spostando l'inizio dell'array
+    dentro il buffer, in O(log n) senza spostare elementi. Lo spazio
+    liberato in testa viene riusato dagli inserimenti, ricentrando gli
+    elementi quando serve (costo ammortizzato).
 
-    @return SortedArray - con soli gli elementi che soddisfano il filtro 
-    @ref insert
-  */
+    Gli elementi scartati restano nel buffer finche' non vengono
+    sovrascritti o il buffer viene liberato.
 
+    @param key primo valore da tenere
 
-  template <typename Policy>
-  SortedArray filter(Policy filt) const
+    @return numero di elementi rimossi
+  */
+  size_type trim_below(const value_type &key)
   {
-    // init things
-    SortedArray<value_type, order_policy, equal_policy> result;
-
-    // reverse to have better insert time
-    for (int i = _size - 1; i >= 0; --i)
-    {
-      if (filt(_array[i]))
-      {
-        try
-        {
-          result.insert(_array[i]);
-        }
-        catch (...)
-        {
-          result.makeEmpty();
-          throw;
-        }
-      }
-    }
-    return result;
+    return erase_positions(0, searchsorted(key));
   }
 
-  /**
-    @brief Accesso alla dimensione dell'array
+ /**
+    @brief Rimozione degli elementi maggiori di key
 
-    Metodo per ottenere la dimensione dell'array
+    Come @ref trim_below() ma dalla coda: l'array viene solo accorciato.
 
-    @return dimensione dell'array dinamico
+    @param key ultimo valore da tenere (anche i suoi equivalenti restano)
+
+    @return numero di elementi rimossi
   */
-  size_type size(void) const
+  size_type trim_above(const value_type &key)
   {
-    return _size;
+    return erase_positions(upper_index(key), _size);
   }
 
+ /**
+    @brief Searchsorted, ritorna indice al quale inserire per mantenere ordine
+    
+    La strategia di ricerca dipende da @ref set_search_mode(); se e'
+    attivo l'indice appreso (@ref enable_learned_index()) si usa quello.
 
-  /**
+    @param item reference di elemento di tipo del SortedArray 
+
+    @return indice al quale si deve inserire 
+  
+*/
+  size_type searchsorted(const value_type& item) const
+  {
+    SORTEDARRAY_STAT(begin_search());
+    size_type index = use_learned_index() ? learned_index(item) : search_index(item);
+    SORTEDARRAY_STAT(end_search());
+    return index;
+  }
+
+ /**
+    @brief Searchsorted con una chiave di tipo K
+
+    Disponibile solo se order_policy dichiara is_transparent e confronta
+    K con T in entrambi i versi. Usa sempre la ricerca binaria: i modelli
+    di interpolazione e l'indice appreso lavorano su valori di tipo T.
+
+    @param key chiave da cercare
+
+    @return primo indice con elemento non minore di key
+  */
+  template <typename K, typename O = order_policy, typename = typename O::is_transparent>
+  size_type searchsorted(const K &key) const
+  {
+    SORTEDARRAY_STAT(begin_search());
+    size_type index = binary_index(key, 0, _size);
+    SORTEDARRAY_STAT(end_search());
+    return index;
+  }
+
+ /**
+    @brief Riserva spazio per almeno n elementi
+
+    Gli inserimenti successivi non riallocano finche' size() <= n: lo
+    spazio libero viene usato sia in testa sia in coda. Per tipi il cui
+    move puo' lanciare ogni inserimento copia in un nuovo buffer, ma della
+    stessa capacita'.
+
+    @param n numero di elementi da poter contenere
+  */
+  void reserve(size_type n)
+  {
+    if (n > _capacity)
+      reallocate(n);
+  }
+
+ /**
+    @brief Limita l'array ai k elementi migliori (top-K)
+
+    Con k > 0 l'array tiene al massimo k elementi: quando e' pieno, un
+    nuovo elemento non migliore del minimo secondo order_policy viene
+    rifiutato in O(1) prima di qualunque ricerca, altrimenti il minimo
+    viene tolto e il nuovo elemento inserito spostando in place quelli
+    che lo precedono. Il buffer viene allocato una volta con capacita' k
+    e non viene piu' riallocato (per tipi con move nothrow).
+
+    Se l'array contiene gia' piu' di k elementi vengono tolti i minori.
+
+    @param k numero massimo di elementi, 0 toglie il limite
+  */
+  void set_bound(size_type k)
+  {
+    if (k != 0 && _size > k)
+      erase_positions(0, _size - k);
+    _bound = k;
+    if (k != 0 && _capacity != k)
+      reallocate(k);
+  }
+
+ /**
+    @brief Limite impostato con @ref set_bound()
+
+    @return numero massimo di elementi, 0 se illimitato
+  */
+  size_type bound() const
+  {
+    return _bound;
+  }
+
+ /**
+    @brief Numero di elementi contenibili senza riallocare
+
+    @return capacita' del buffer
+  */
+  size_type capacity() const
+  {
+    return _capacity;
+  }
+
+ /**
+    @brief Imposta la strategia di ricerca
+
+    @param mode una delle strategie di @ref search_mode
+  */
+  void set_search_mode(search_mode mode)
+  {
+    _search_mode = mode;
+    _sampled.store(false, std::memory_order_relaxed);
+  }
+
+ /**
+    @brief Strategia di ricerca impostata
+
+    @return strategia impostata con @ref set_search_mode()
+  */
+  search_mode get_search_mode() const
+  {
+    return _search_mode;
+  }
+
+ /**
+    @brief Attiva l'indice appreso
+
+    Su array numerici grandi e poco modificati searchsorted usa un modello
+    lineare a tratti (@ref LearnedIndex) che predice la posizione con errore
+    massimo epsilon e poi cerca solo nell'intorno della predizione.
+    Il modello viene ricostruito in modo pigro alla prima ricerca dopo una
+    modifica, sotto un mutex: piu' thread possono cercare insieme.
+    Non ha effetto se T non e' aritmetico.
+
+    @param epsilon errore massimo del modello, 0 disattiva l'indice
+  */
+  void enable_learned_index(size_type epsilon = 32)
+  {
+    _learned_epsilon = epsilon;
+    _learned_ready.store(false, std::memory_order_relaxed);
+  }
+
+ /**
+    @brief Disattiva l'indice appreso e libera il modello
+  */
+  void disable_learned_index()
+  {
+    delete _learned;
+    _learned = nullptr;
+    _learned_epsilon = 0;
+    _learned_ready.store(false, std::memory_order_relaxed);
+  }
+
+ /**
+    @brief Memoria occupata dall'indice appreso
+
+    @return dimensione in byte del modello, 0 se non costruito
+  */
+  size_type learned_index_bytes() const
+  {
+    return (_learned_ready.load(std::memory_order_acquire) && _learned != nullptr)
+               ? _learned->bytes()
+               : 0;
+  }
+
+ /**
+    @brief Attiva il filtro di appartenenza
+
+    find e count consultano prima un filtro di Bloom a blocchi
+    (@ref BlockedBloomFilter): se la chiave di sicuro non e' presente
+    rispondono leggendo una sola linea di cache, senza cercare
+    nell'array. Conviene quando la maggior parte delle ricerche fallisce.
+
+    Il filtro viene costruito subito, con spazio per il doppio degli
+    elementi attuali. Ogni insert aggiunge la nuova chiave; le rimozioni
+    non lo rendono sbagliato (al piu' risponde "forse" per chiavi tolte),
+    quindi viene ricostruito, dentro l'operazione che modifica l'array,
+    solo quando le chiavi presenti piu' quelle tolte superano lo spazio
+    previsto. find e count si limitano a leggerlo.
+
+    H deve essere coerente con equal_policy: elementi uguali devono avere
+    lo stesso hash.
+
+    @param fpr tasso di falsi positivi desiderato, circa
+
+    @post i contatori di @ref filter_stats() sono azzerati
+
+    @throw std::bad_alloc o le eccezioni di H; il filtro resta spento
+  */
+  template <typename H = std::hash<value_type>>
+  void enable_filter(double fpr = 0.01)
+  {
+    _filter_fpr = fpr;
+    _filter_hash = &hash_with<H>;
+    _filter_rejected.store(0, std::memory_order_relaxed);
+    _filter_passed.store(0, std::memory_order_relaxed);
+    _filter_false_positives.store(0, std::memory_order_relaxed);
+    try
+    {
+      build_filter();
+    }
+    catch (...)
+    {
+      disable_filter();
+      throw;
+    }
+  }
+
+ /**
+    @brief Disattiva il filtro di appartenenza e ne libera la memoria
+  */
+  void disable_filter()
+  {
+    _filter_hash = nullptr;
+    _filter_ready = false;
+    delete _filter;
+    _filter = nullptr;
+  }
+
+ /**
+    @brief Memoria occupata dal filtro di appartenenza
+
+    @return dimensione in byte, 0 se il filtro non e' costruito
+  */
+  size_type filter_bytes() const
+  {
+    return (_filter_ready && _filter != nullptr) ? _filter->bytes() : 0;
+  }
+
+ /**
+    @brief Contatori del filtro di appartenenza
+
+    I contatori sono atomici: si possono leggere mentre altri thread
+    cercano nell'array.
+
+    @return copia dei contatori
+  */
+  sortedarray_filter_stats filter_stats() const
+  {
+    sortedarray_filter_stats stats;
+    stats.rejected = _filter_rejected.load(std::memory_order_relaxed);
+    stats.passed = _filter_passed.load(std::memory_order_relaxed);
+    stats.false_positives = _filter_false_positives.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  // int searchsorted(const value_type &item) const
+  // {
+  //   order_policy ord;
+  //   if (_size == 0)
+  //   {
+  //     return 0;
+  //   }
+  //   for (int i = 0; i < _size; ++i)
+  //   {
+  //     if (ord(item, _array[i]))
+  //     {
+  //       return i;
+  //     }
+  //   }
+  //   return _size;
+  // }
+
+ /**
+    @brief makeEmpty - svuota
+    
+    Funzione che svuota array e inizializza a zero la struttura dati occupandosi della memoria
+
+
+    @post _size = 0
+    @post _array = nullptr  
+  */
+  void makeEmpty()
+  {
+    release();
+    _filter_stale += _size;
+    _size = 0;
+    invalidate();
+    refresh_filter();
+    return;
+  }
+
+ /**
+    @brief find - ricerca un elemento se presente
+    
+    Inserimento di un elemento nel SortedArray in posizione ordinata
+
+    @param item reference di elemento di tipo del SortedArray 
+
+    @return 1, trovato, 
+    @return 0, non trovato  
+  */
+  bool find(const value_type &target) const
+  {
+    if (filter_rejects(target))
+      return false;
+    return filter_outcome(get_index_of(target) != npos);
+  }
+
+ /**
+    @brief find con una chiave di tipo K
+
+    Disponibile solo se order_policy e equal_policy dichiarano
+    is_transparent e accettano K insieme a T.
+
+    @param key chiave da cercare
+
+    @return true se esiste un elemento uguale a key
+  */
+  template <typename K, typename O = order_policy, typename E = equal_policy,
+            typename = typename O::is_transparent, typename = typename E::is_transparent>
+  bool find(const K &key) const
+  {
+    return get_index_of(key) != npos;
+  }
+
+ /**
+    @brief count - numero di occorrenze di un elemento
+
+    Conta gli elementi uguali a target secondo equal_policy, cercandoli
+    solo tra quelli equivalenti per order_policy.
+
+    @param target elemento da contare
+
+    @return numero di occorrenze, O(log n + occorrenze)
+  */
+  size_type count(const value_type &target) const
+  {
+    if (filter_rejects(target))
+      return 0;
+    size_type n = count_from(target, searchsorted(target));
+    filter_outcome(n != 0);
+    return n;
+  }
+
+ /**
+    @brief count con una chiave di tipo K
+
+    Disponibile solo se order_policy e equal_policy dichiarano
+    is_transparent e accettano K insieme a T.
+
+    @param key chiave da contare
+
+    @return numero di elementi uguali a key
+  */
+  template <typename K, typename O = order_policy, typename E = equal_policy,
+            typename = typename O::is_transparent, typename = typename E::is_transparent>
+  size_type count(const K &key) const
+  {
+    return count_from(key, searchsorted(key));
+  }
+
+/**
+    @brief Conta gli elementi con chiave in [lo, hi)
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+
+    @return numero di elementi nell'intervallo, O(log n)
+  */
+  size_type range_count(const value_type &lo, const value_type &hi) const
+  {
+    size_type first = searchsorted(lo);
+    size_type last = searchsorted(hi);
+    return (last > first) ? last - first : 0;
+  }
+
+/**
+    @brief Somma degli elementi con chiave in [lo, hi)
+
+    Acc sceglie il tipo in cui accumulare (ad esempio long long per non
+    andare in overflow sommando int), proj il valore da sommare per ogni
+    elemento (ad esempio un campo di una struct).
+
+    Usa somme prefisse, costruite in modo pigro alla prima chiamata dopo
+    una modifica e tenute per ogni coppia (Acc, proj): O(log n). Vale con
+    i parametri di default, se T ha operator+ e operator- e T() e'
+    l'elemento neutro, e con Acc aritmetico e proj senza stato (una classe
+    vuota, come una lambda senza catture). Per gli interi il risultato e'
+    esatto se la somma dell'intervallo sta in Acc, anche quando il totale
+    dell'array non ci sta; in virgola mobile e' la differenza di due
+    prefissi e puo' scostarsi di qualche ulp dalla somma diretta. Ogni
+    coppia usata tiene n + 1 valori fino alla modifica successiva.
+
+    Negli altri casi (proj con stato, Acc non aritmetico) la somma scorre
+    l'intervallo: O(log n + elementi sommati).
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+    @param proj funtore che dato un elemento restituisce il valore da sommare
+
+    @return somma, di tipo Acc, dei valori proiettati nell'intervallo
+  */
+  template <typename Acc = value_type, typename Proj = sortedarray_identity>
+  Acc range_sum(const value_type &lo, const value_type &hi, Proj proj = Proj()) const
+  {
+    return sum_positions<Acc>(searchsorted(lo), searchsorted(hi), proj);
+  }
+
+/**
+    @brief Minimo (secondo order_policy) degli elementi in [lo, hi)
+
+    L'array e' ordinato, quindi il minimo e' il primo elemento
+    dell'intervallo.
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+
+    @return reference al minimo, O(log n)
+
+    @pre range_count(lo, hi) > 0
+  */
+  const value_type &range_min(const value_type &lo, const value_type &hi) const
+  {
+    size_type first = searchsorted(lo);
+    assert(first < searchsorted(hi));
+    return _array[first];
+  }
+
+/**
+    @brief Massimo (secondo order_policy) degli elementi in [lo, hi)
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+
+    @return reference al massimo, O(log n)
+
+    @pre range_count(lo, hi) > 0
+  */
+  const value_type &range_max(const value_type &lo, const value_type &hi) const
+  {
+    size_type last = searchsorted(hi);
+    assert(searchsorted(lo) < last);
+    return _array[last - 1];
+  }
+
+/**
+    @brief Elemento con la proiezione minima tra quelli in [lo, hi)
+
+    Confronta i valori proj(x) con operator<; a parita' restituisce il
+    primo. Con proj senza stato usa una sparse table di posizioni,
+    costruita in modo pigro alla prima chiamata dopo una modifica in
+    O(n log n) tempo e memoria e tenuta per ogni proj: O(log n). Con proj
+    con stato scorre l'intervallo, O(log n + elementi).
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+    @param proj funtore che dato un elemento restituisce il valore da confrontare
+
+    @return reference all'elemento
+
+    @pre range_count(lo, hi) > 0
+  */
+  template <typename Proj>
+  const value_type &range_min(const value_type &lo, const value_type &hi, Proj proj) const
+  {
+    size_type first = searchsorted(lo);
+    size_type last = searchsorted(hi);
+    assert(first < last);
+    return _array[extreme_position<false>(first, last, proj)];
+  }
+
+/**
+    @brief Elemento con la proiezione massima tra quelli in [lo, hi)
+
+    Come @ref range_min(const value_type &, const value_type &, Proj) const.
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+    @param proj funtore che dato un elemento restituisce il valore da confrontare
+
+    @return reference all'elemento
+
+    @pre range_count(lo, hi) > 0
+  */
+  template <typename Proj>
+  const value_type &range_max(const value_type &lo, const value_type &hi, Proj proj) const
+  {
+    size_type first = searchsorted(lo);
+    size_type last = searchsorted(hi);
+    assert(first < last);
+    return _array[extreme_position<true>(first, last, proj)];
+  }
+
+/**
+    @brief Interrogazioni su intervalli con chiavi di tipo K
+
+    Come le versioni con estremi di tipo T; disponibili solo se
+    order_policy dichiara is_transparent e confronta K con T.
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+  */
+  template <typename K, typename O = order_policy, typename = typename O::is_transparent>
+  size_type range_count(const K &lo, const K &hi) const
+  {
+    size_type first = searchsorted(lo);
+    size_type last = searchsorted(hi);
+    return (last > first) ? last - first : 0;
+  }
+
+  template <typename Acc = value_type, typename K, typename Proj = sortedarray_identity,
+            typename O = order_policy, typename = typename O::is_transparent>
+  Acc range_sum(const K &lo, const K &hi, Proj proj = Proj()) const
+  {
+    return sum_positions<Acc>(searchsorted(lo), searchsorted(hi), proj);
+  }
+
+  template <typename K, typename O = order_policy, typename = typename O::is_transparent>
+  const value_type &range_min(const K &lo, const K &hi) const
+  {
+    size_type first = searchsorted(lo);
+    assert(first < searchsorted(hi));
+    return _array[first];
+  }
+
+  template <typename K, typename O = order_policy, typename = typename O::is_transparent>
+  const value_type &range_max(const K &lo, const K &hi) const
+  {
+    size_type last = searchsorted(hi);
+    assert(searchsorted(lo) < last);
+    return _array[last - 1];
+  }
+
+  template <typename K, typename Proj, typename O = order_policy, typename = typename O::is_transparent>
+  const value_type &range_min(const K &lo, const K &hi, Proj proj) const
+  {
+    size_type first = searchsorted(lo);
+    size_type last = searchsorted(hi);
+    assert(first < last);
+    return _array[extreme_position<false>(first, last, proj)];
+  }
+
+  template <typename K, typename Proj, typename O = order_policy, typename = typename O::is_transparent>
+  const value_type &range_max(const K &lo, const K &hi, Proj proj) const
+  {
+    size_type first = searchsorted(lo);
+    size_type last = searchsorted(hi);
+    assert(first < last);
+    return _array[extreme_position<true>(first, last, proj)];
+  }
+
+/**
+    @brief Filter - filtra l'array e restituisce un altro SortedArray
+    
+
+    @param filt Policy che vogliamo usare per filtrare l'array, una sua istanza confrontando un elemento di tipo value_type con l'operatore (), deve restituire un boolean
+
+    @return SortedArray - con soli gli elementi che soddisfano il filtro 
+    @ref insert
+  */
+
+
+  template <typename Policy>
+  SortedArray filter(Policy filt) const
+  {
+    // init things
+    SortedArray result;
+
+    // gli elementi arrivano gia' ordinati: si aggiungono in coda, O(1) ammortizzato
+    for (size_type i = 0; i < _size; ++i)
+    {
+      if (filt(_array[i]))
+      {
+        try
+        {
+          result.insert_at(result._size, _array[i]);
+        }
+        catch (...)
+        {
+          result.makeEmpty();
+          throw;
+        }
+      }
+    }
+    SORTEDARRAY_STAT(_stats.filter_tested += _size);
+    SORTEDARRAY_STAT(_stats.filter_selected += result.size());
+    return result;
+  }
+
+  /**
+    @brief Accesso alla dimensione dell'array
+
+    Metodo per ottenere la dimensione dell'array
+
+    @return dimensione dell'array dinamico
+  */
+  size_type size(void) const
+  {
+    return _size;
+  }
+
+
+  /**
     @brief Getter della cella index-esima
 
-    Metodo che permette di leggere la cella
-    index-esima dell'array. Il metodo si può usare
-    solo su istanze costanti della classe.
+    Metodo che permette di leggere la cella
+    index-esima dell'array. Il metodo si può usare
+    solo su istanze costanti della classe.
+
+    @param index della cella da leggere
+
+    @return reference alla cella index-esima
+
+    @pre index < size()
+  */
+  const value_type &operator[](size_type index) const
+  {
+    assert(index < _size);
+    
+    return _array[index];
+  }
+
+  /**
+    @brief Contatori di profilazione dell'istanza
+
+    I contatori sono aggiornati solo se si compila con SORTEDARRAY_STATS,
+    altrimenti sono sempre a zero e non costano nulla.
+
+    @return reference ai contatori
+  */
+  const sortedarray_stats &stats() const
+  {
+#ifdef SORTEDARRAY_STATS
+    return _stats;
+#else
+    static const sortedarray_stats none;
+    return none;
+#endif
+  }
+
+  /**
+    @brief Azzera i contatori di profilazione
+  */
+  void reset_stats()
+  {
+    SORTEDARRAY_STAT(_stats.reset());
+  }
+
+  /**
+    @brief Metodo swap per la classe SortedArray
+
+    Funzione che scambia il contenuto di due SortedArray
+
+    @param other il SortedArray con cui scambiare il contenuto
+  */
+  void swap(SortedArray &other)
+  {
+    std::swap(_array, other._array);
+    std::swap(_size, other._size);
+    std::swap(_refs, other._refs);
+    std::swap(_buffer, other._buffer);
+    std::swap(_capacity, other._capacity);
+    std::swap(_bound, other._bound);
+    std::swap(_search_mode, other._search_mode);
+    swap_atomic(_sampled, other._sampled);
+    std::swap(_interpolate, other._interpolate);
+    std::swap(_learned, other._learned);
+    std::swap(_learned_epsilon, other._learned_epsilon);
+    swap_atomic(_learned_ready, other._learned_ready);
+    std::swap(_learned_usable, other._learned_usable);
+    swap_atomic(_tables, other._tables);
+    std::swap(_filter_fpr, other._filter_fpr);
+    std::swap(_filter_hash, other._filter_hash);
+    std::swap(_filter, other._filter);
+    std::swap(_filter_keys, other._filter_keys);
+    std::swap(_filter_stale, other._filter_stale);
+    std::swap(_filter_ready, other._filter_ready);
+    swap_atomic(_filter_rejected, other._filter_rejected);
+    swap_atomic(_filter_passed, other._filter_passed);
+    swap_atomic(_filter_false_positives, other._filter_false_positives);
+  }
+
+/**
+    @brief Classe che rappresenta un iteratore di tipo random_access_iterator
+
+    sfrutta la struttura della classe SortedArray per implementare un puntatore random access.
+    L'iteratore e' costante, come quello di std::set: scrivere attraverso
+    di esso potrebbe rompere l'ordinamento.
+    Con C++20 soddisfa std::contiguous_iterator, quindi gli algoritmi di
+    std::ranges lavorano direttamente sul buffer.
+    
+    @ref SortedArray::begin()
+    @ref SortedArray::end()
+  */
+    class const_iterator
+  {
+    //
+  public:
+    typedef std::random_access_iterator_tag iterator_category;
+#if __cplusplus >= 202002L
+    typedef std::contiguous_iterator_tag iterator_concept;
+#endif
+    typedef T value_type;
+    typedef const T element_type;
+    typedef ptrdiff_t difference_type;
+    typedef const T *pointer;
+    typedef const T &reference;
+
+    const_iterator() : ptr(nullptr)
+    {
+    }
+
+    // Ritorna il dato riferito dall'iteratore (dereferenziamento)
+    reference operator*() const
+    {
+      return *ptr;
+    }
+
+    // Ritorna il puntatore al dato riferito dall'iteratore
+    pointer operator->() const
+    {
+      return ptr;
+    }
+
+    // Operatore di accesso random
+    reference operator[](difference_type index) const
+    {
+      return ptr[index];
+    }
+
+    // Operatore di iterazione post-incremento
+    const_iterator operator++(int)
+    {
+      const_iterator old(*this);
+      ++ptr;
+      return old;
+    }
+
+    // Operatore di iterazione pre-incremento
+    const_iterator &operator++()
+    {
+      ++ptr;
+      return *this;
+    }
+
+    // Operatore di iterazione post-decremento
+    const_iterator operator--(int)
+    {
+      const_iterator old(*this);
+      --ptr;
+      return old;
+    }
+
+    // Operatore di iterazione pre-decremento
+    const_iterator &operator--()
+    {
+      --ptr;
+      return *this;
+    }
+
+    // Spostamentio in avanti della posizione
+    const_iterator operator+(difference_type offset) const
+    {
+      return const_iterator(ptr + offset);
+    }
+
+    // Spostamentio in avanti della posizione (offset + iteratore)
+    friend const_iterator operator+(difference_type offset, const const_iterator &it)
+    {
+      return const_iterator(it.ptr + offset);
+    }
+
+    // Spostamentio all'indietro della posizione
+    const_iterator operator-(difference_type offset) const
+    {
+      return const_iterator(ptr - offset);
+    }
+
+    // Spostamentio in avanti della posizione
+    const_iterator &operator+=(difference_type offset)
+    {
+      ptr += offset;
+      return *this;
+    }
+
+    // Spostamentio all'indietro della posizione
+    const_iterator &operator-=(difference_type offset)
+    {
+      ptr -= offset;
+      return *this;
+    }
+
+    // Numero di elementi tra due iteratori
+    difference_type operator-(const const_iterator &other) const
+    {
+      return ptr - other.ptr;
+    }
+
+    // Uguaglianza
+    bool operator==(const const_iterator &other) const
+    {
+      return ptr == other.ptr;
+    }
+
+    // Diversita'
+    bool operator!=(const const_iterator &other) const
+    {
+      return ptr != other.ptr;
+    }
+
+    // Confronto
+    bool operator>(const const_iterator &other) const
+    {
+      return ptr > other.ptr;
+    }
+
+    bool operator>=(const const_iterator &other) const
+    {
+      return ptr >= other.ptr;
+    }
+
+    // Confronto
+    bool operator<(const const_iterator &other) const
+    {
+      return ptr < other.ptr;
+    }
+
+    // Confronto
+    bool operator<=(const const_iterator &other) const
+    {
+      return ptr <= other.ptr;
+    }
+
+  private:
+
+    const T *ptr;
+    friend class SortedArray;
+    
+    explicit const_iterator(const T *p) : ptr(p)
+    {
+    }
+
+  }; // classe const_iterator
+
+  /// Anche iterator e' costante, come in std::set
+  typedef const_iterator iterator;
+  typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+  typedef const_reverse_iterator reverse_iterator;
+
+/**
+    @brief Iteratore inizio sequenza
+    
+    @return iteratore 
+    @ref const_iterator
+  */
+  const_iterator begin() const
+  {
+    return const_iterator(_array);
+  }
+
+/**
+    @brief Iteratore fine sequenza
+    
+    nota: non dereferenzializzarlo : non punta a nessun valore appartenente all'array
+    
+    @return iteratore 
+    @ref const_iterator
+  */
+  const_iterator end() const
+  {
+    return const_iterator(_array + _size);
+  }
+
+/**
+    @brief Iteratore costante inizio sequenza
+
+    @return iteratore
+  */
+  const_iterator cbegin() const
+  {
+    return begin();
+  }
+
+/**
+    @brief Iteratore costante fine sequenza
+
+    @return iteratore
+  */
+  const_iterator cend() const
+  {
+    return end();
+  }
+
+/**
+    @brief Iteratore inverso, parte dall'ultimo elemento
+
+    @return iteratore inverso
+  */
+  const_reverse_iterator rbegin() const
+  {
+    return const_reverse_iterator(end());
+  }
+
+/**
+    @brief Iteratore inverso fine sequenza
+
+    @return iteratore inverso
+  */
+  const_reverse_iterator rend() const
+  {
+    return const_reverse_iterator(begin());
+  }
+
+  const_reverse_iterator crbegin() const
+  {
+    return rbegin();
+  }
+
+  const_reverse_iterator crend() const
+  {
+    return rend();
+  }
+
+/**
+    @brief Accesso diretto al buffer
+
+    Gli elementi sono contigui e ordinati in [data(), data() + size()),
+    quindi si possono passare senza copie a funzioni che lavorano su
+    puntatori (es. librerie SIMD). Con C++20 un SortedArray si converte
+    implicitamente in std::span<const T>, perche' e' un contiguous_range.
+
+    @return puntatore al primo elemento, nullptr se l'array e' vuoto
+  */
+  const value_type *data() const
+  {
+    return _array;
+  }
+
+ /**
+    @brief Rimozione di un intervallo di elementi
+
+    Rimuove gli elementi in [first, last) compattando l'array in un solo
+    passaggio, senza riallocare.
+
+    @param first iteratore al primo elemento da rimuovere
+    @param last iteratore successivo all'ultimo elemento da rimuovere
+
+    @return iteratore all'elemento che seguiva l'ultimo rimosso
+  */
+  iterator erase(const_iterator first, const_iterator last)
+  {
+    // posizioni calcolate prima di un'eventuale copia del buffer condiviso
+    size_type from = first.ptr - _array;
+    size_type to = last.ptr - _array;
+    erase_positions(from, to);
+    return const_iterator(_array + from);
+  }
+
+ /**
+    @brief Rimozione di un elemento tramite iteratore
+
+    @param pos iteratore all'elemento da rimuovere
+
+    @return iteratore all'elemento successivo
+  */
+  iterator erase(const_iterator pos)
+  {
+    return erase(pos, pos + 1);
+  }
+
+ /**
+    @brief Inserimento di un elemento vicino a una posizione nota
+
+    La posizione viene cercata con una ricerca esponenziale che parte da
+    hint: O(log d) confronti, con d distanza tra hint e la posizione
+    finale. Con hint = end() gli inserimenti in coda di chiavi crescenti
+    (serie temporali) costano O(1) ammortizzato.
+
+    Il risultato non dipende da hint, che serve solo come punto di
+    partenza: un hint sbagliato costa al massimo O(log n).
+
+    @param hint iteratore vicino alla posizione di inserimento
+    @param item elemento da inserire
+
+    @return iteratore all'elemento inserito; con unique_policy, se era gia'
+            presente, iteratore all'elemento uguale; end() se rifiutato
+            dal limite di @ref set_bound()
+  */
+  iterator insert(const_iterator hint, const value_type &item)
+  {
+    bool inserted;
+    size_type index = insert_near(hint.ptr - _array, item, inserted);
+    if (index == npos)
+      return end();
+    return const_iterator(_array + index);
+  }
+
+ /**
+    @brief Primo elemento non minore di key, cercato a partire da hint
+
+    Ricerca esponenziale verso sinistra o verso destra da hint, poi
+    bisezione: O(log d) confronti, con d distanza tra hint e il risultato.
+    Conviene per sequenze di ricerche su chiavi vicine.
+
+    @param hint iteratore vicino al risultato atteso
+    @param key chiave da cercare
+
+    @return iteratore al primo elemento non minore di key, end() se nessuno
+  */
+  const_iterator lower_bound(const_iterator hint, const value_type &key) const
+  {
+    SORTEDARRAY_STAT(begin_search());
+    size_type index = gallop_from(key, hint.ptr - _array);
+    SORTEDARRAY_STAT(end_search());
+    return const_iterator(_array + index);
+  }
+
+/**
+    @brief Cursore per accessi localizzati
+
+    Ricorda la posizione dell'ultima operazione e fa partire da li' la
+    ricerca esponenziale successiva: su flussi di chiavi vicine o crescenti
+    ogni seek e ogni insert costano O(log d), con d distanza percorsa.
+
+    Il cursore resta valido dopo le modifiche dell'array (la posizione
+    viene solo usata come punto di partenza), ma non deve sopravvivere
+    all'array a cui si riferisce.
+  */
+  class cursor
+  {
+  public:
+    explicit cursor(SortedArray &owner) : _owner(&owner), _pos(0)
+    {
+    }
+
+    /**
+      @brief Sposta il cursore sul primo elemento non minore di key
+
+      @param key chiave da cercare
+
+      @return nuova posizione, come searchsorted(key)
+    */
+    size_type seek(const value_type &key)
+    {
+      SORTEDARRAY_STAT(_owner->begin_search());
+      _pos = _owner->gallop_from(key, _pos);
+      SORTEDARRAY_STAT(_owner->end_search());
+      return _pos;
+    }
+
+    /**
+      @brief Inserisce item cercando la posizione a partire dal cursore
+
+      Il cursore si sposta subito dopo l'elemento inserito, pronto per
+      una chiave successiva.
+
+      @param item elemento da inserire
+
+      @return true se l'elemento e' stato inserito
+    */
+    bool insert(const value_type &item)
+    {
+      bool inserted;
+      size_type index = _owner->insert_near(_pos, item, inserted);
+      if (index != npos)
+        _pos = index + 1;
+      return inserted;
+    }
+
+    /// Posizione corrente del cursore
+    size_type position() const
+    {
+      return _pos;
+    }
+
+  private:
+    SortedArray *_owner;
+    size_type _pos;
+  };
+
+private:
+  // la specializzazione run_length_policy eredita da questa classe e ne
+  // riusa ricerca e gestione del buffer
+  template <typename, typename, typename, typename>
+  friend class SortedArray;
+
+  // indice non valido, usato come "non trovato"
+  static const size_type npos = static_cast<size_type>(-1);
+
+  // lunghezza sotto la quale l'interpolazione non conviene
+  static const size_type interpolation_cutoff = 16;
+  // numero di campioni usati dalla modalita' adattiva
+  static const size_type adaptive_samples = 32;
+
+  // primo indice in cui item andrebbe inserito dopo gli equivalenti
+  size_type upper_index(const value_type &item) const
+  {
+    order_policy ord;
+    size_type under = 0;
+    size_type upper = _size;
+    SORTEDARRAY_STAT(begin_search());
+    while (under < upper)
+    {
+      size_type mid = under + (upper - under) / 2;
+      SORTEDARRAY_STAT(count_probe());
+      if (ord(item, _array[mid]))
+        upper = mid;
+      else
+        under = mid + 1;
+    }
+    SORTEDARRAY_STAT(end_search());
+    return under;
+  }
+
+  /*
+    Inserisce item in posizione index. Se il buffer non e' condiviso e ha
+    spazio libero, in place: si sposta la parte piu' corta tra quella che
+    precede index (verso lo spazio in testa) e quella che segue (verso lo
+    spazio in coda). Se lo spazio c'e' solo dal lato sbagliato ed e'
+    almeno un quarto degli elementi, gli elementi vengono prima ricentrati
+    nel buffer, altrimenti si sposta la parte piu' lunga. Solo con il
+    buffer pieno si alloca un buffer di capacita' doppia, cosi' n
+    inserimenti in coda costano O(n) in totale. Lo spostamento in place
+    richiede move nothrow, in modo che un'eccezione lasci l'array
+    invariato.
+  */
+  void insert_at(size_type index, const value_type &item)
+  {
+    if (std::is_nothrow_move_assignable<value_type>::value && _refs != nullptr &&
+        _refs->load(std::memory_order_acquire) == 1)
+    {
+      bool left = index < _size - index;
+      if (left ? front_slack() == 0 : back_slack() == 0)
+      {
+        size_type slack = front_slack() + back_slack();
+        if (slack != 0 && slack >= _size / 4)
+          recenter(left);
+      }
+      // se un lato e' pieno si usa l'altro, anche se lo spostamento e'
+      // piu' lungo: il buffer si rialloca solo quando e' davvero pieno
+      if (front_slack() == 0)
+        left = false;
+      else if (back_slack() == 0)
+        left = true;
+
+      // copia preventiva: item potrebbe essere un elemento dell'array
+      if (left)
+      {
+        value_type copy(item);
+        SORTEDARRAY_STAT(count_insert(index));
+        --_array;
+        for (size_type i = 0; i < index; ++i)
+          _array[i] = std::move(_array[i + 1]);
+        _array[index] = std::move(copy);
+        SORTEDARRAY_STAT(_stats.bytes_moved +=
+                         static_cast<unsigned long long>(index) * sizeof(value_type));
+        ++_size;
+        invalidate();
+        return;
+      }
+      if (back_slack() != 0)
+      {
+        value_type copy(item);
+        SORTEDARRAY_STAT(count_insert(_size - index));
+        for (size_type i = _size; i > index; --i)
+          _array[i] = std::move(_array[i - 1]);
+        _array[index] = std::move(copy);
+        SORTEDARRAY_STAT(_stats.bytes_moved +=
+                         static_cast<unsigned long long>(_size - index) * sizeof(value_type));
+        ++_size;
+        invalidate();
+        return;
+      }
+    }
+
+    SORTEDARRAY_STAT(count_insert(_size - index));
+    // con spazio libero (buffer condiviso o move che puo' lanciare) la
+    // capacita' non cambia, altrimenti raddoppia
+    size_type capacity = (_bound != 0)          ? _bound
+                         : (_size < _capacity) ? _capacity
+                         : (_size < 4)         ? 4
+                                               : 2 * _size;
+    value_type *new_array = new value_type[capacity];
+    SORTEDARRAY_STAT(count_copy(_size));
+
+    // copy first part
+    for (size_type i = 0; i < index; ++i)
+    {
+      try
+      {
+        new_array[i] = _array[i];
+      }
+      catch (...)
+      {
+        delete[] new_array;
+        throw;
+      }
+    }
+
+    // insert
+    try
+    {
+      new_array[index] = item;
+    }
+    catch (...)
+    {
+      delete[] new_array;
+      throw;
+    }
+
+    // copy second part
+    for (size_type i = index; i < _size; i++)
+    {
+      try
+      {
+        new_array[i + 1] = _array[i];
+      }
+      catch (...)
+      {
+        delete[] new_array;
+        throw;
+      }
+    }
+
+    adopt(new_array, capacity);
+    _size += 1;
+    invalidate();
+  }
+
+  // inserimento con ricerca esponenziale a partire da pos; restituisce
+  // l'indice dell'elemento inserito (o di quello uguale, con unique_policy)
+  size_type insert_near(size_type pos, const value_type &item, bool &inserted)
+  {
+    inserted = false;
+    if (rejected_by_bound(item))
+      return npos;
+
+    SORTEDARRAY_STAT(begin_search());
+    size_type index = gallop_from(item, pos);
+    SORTEDARRAY_STAT(end_search());
+
+    if (std::is_same<duplicate_policy, unique_policy>::value)
+    {
+      size_type found = match_from(item, index);
+      if (found != npos)
+        return found;
+    }
+
+    inserted = true;
+    return place(index, item);
+  }
+
+  // con l'array pieno accetta solo elementi migliori del minimo
+  bool rejected_by_bound(const value_type &item) const
+  {
+    order_policy ord;
+    if (_bound == 0 || _size < _bound)
+      return false;
+    SORTEDARRAY_STAT(++_stats.comparisons);
+    return !ord(_array[0], item);
+  }
+
+  // inserisce item nella posizione di ricerca index, togliendo il minimo
+  // se l'array ha raggiunto il limite; restituisce la posizione finale
+  size_type place(size_type index, const value_type &item)
+  {
+    // l'hash si calcola prima: item potrebbe stare nell'array
+    std::size_t hash = _filter_ready ? _filter_hash(item) : 0;
+
+    if (_bound != 0 && _size >= _bound)
+    {
+      evict_insert(index, item);
+      ++_filter_stale;
+      --index;
+    }
+    else
+      insert_at(index, item);
+
+    if (_filter_ready)
+      _filter->add(hash);
+    refresh_filter();
+    return index;
+  }
+
+  /*
+    Array pieno: toglie il minimo _array[0] e mette item in index - 1,
+    spostando indietro di una posizione gli elementi che lo precedono.
+    La dimensione non cambia e il buffer non viene riallocato (salvo
+    copiarlo se condiviso o se il move puo' lanciare).
+  */
+  void evict_insert(size_type index, const value_type &item)
+  {
+    SORTEDARRAY_STAT(count_insert(index - 1));
+
+    if (std::is_nothrow_move_assignable<value_type>::value &&
+        _refs->load(std::memory_order_acquire) == 1)
+    {
+      // copia preventiva: item potrebbe essere un elemento dell'array
+      value_type copy(item);
+      for (size_type i = 0; i + 1 < index; ++i)
+        _array[i] = std::move(_array[i + 1]);
+      _array[index - 1] = std::move(copy);
+      SORTEDARRAY_STAT(_stats.bytes_moved +=
+                       static_cast<unsigned long long>(index - 1) * sizeof(value_type));
+      invalidate();
+      return;
+    }
+
+    value_type *new_array = new value_type[_capacity];
+    SORTEDARRAY_STAT(count_copy(_size - 1));
+    try
+    {
+      for (size_type i = 1; i < index; ++i)
+        new_array[i - 1] = _array[i];
+      new_array[index - 1] = item;
+      for (size_type i = index; i < _size; ++i)
+        new_array[i] = _array[i];
+    }
+    catch (...)
+    {
+      delete[] new_array;
+      throw;
+    }
+    adopt(new_array, _capacity);
+    invalidate();
+  }
+
+  // sposta gli elementi in un buffer di capacity elementi (>= _size)
+  void reallocate(size_type capacity)
+  {
+    value_type *new_array = new value_type[capacity];
+    SORTEDARRAY_STAT(count_copy(_size));
+    try
+    {
+      for (size_type i = 0; i < _size; ++i)
+        new_array[i] = _array[i];
+    }
+    catch (...)
+    {
+      delete[] new_array;
+      throw;
+    }
+    adopt(new_array, capacity);
+  }
+
+  // toglie le posizioni [from, to) spostando indietro la coda
+  // un prefisso o un suffisso si tolgono in O(1) senza scrivere nel buffer
+  size_type erase_positions(size_type from, size_type to)
+  {
+    if (from >= to)
+      return 0;
+    size_type removed = to - from;
+    if (from == 0)
+    {
+      _array += to;
+      shrink_to(_size - to);
+      return removed;
+    }
+    if (to == _size)
+    {
+      shrink_to(from);
+      return removed;
+    }
+    return compact(from, to, [](const value_type &)
+                   { return true; });
+  }
+
+  // elementi liberi nel buffer prima del primo elemento
+  size_type front_slack() const
+  {
+    return _array - _buffer;
+  }
+
+  // elementi liberi nel buffer dopo l'ultimo elemento
+  size_type back_slack() const
+  {
+    return _capacity - front_slack() - _size;
+  }
+
+  /*
+    Sposta gli elementi in modo da dividere lo spazio libero tra testa e
+    coda (l'elemento in piu' va dal lato di front). Costa O(size) ma
+    lascia almeno size / 8 posti liberi per lato, quindi ammortizzato
+    su altrettanti inserimenti.
+    @pre buffer non condiviso e move nothrow
+  */
+  void recenter(bool front)
+  {
+    size_type slack = front_slack() + back_slack();
+    value_type *target = _buffer + (slack + (front ? 1 : 0)) / 2;
+    if (target < _array)
+      for (size_type i = 0; i < _size; ++i)
+        target[i] = std::move(_array[i]);
+    else if (target > _array)
+      for (size_type i = _size; i-- > 0;)
+        target[i] = std::move(_array[i]);
+    SORTEDARRAY_STAT(_stats.bytes_moved +=
+                     static_cast<unsigned long long>(_size) * sizeof(value_type));
+    _array = target;
+  }
+
+  /*
+    Toglie gli elementi in [from, to) che soddisfano pred con un solo
+    passaggio: ogni elemento sopravvissuto viene spostato al massimo una
+    volta e il buffer non viene riallocato (salvo copiarlo se condiviso).
+    Se pred lancia, gli elementi non ancora esaminati vengono tenuti e
+    l'array resta ordinato e senza buchi.
+  */
+  template <typename Pred>
+  size_type compact(size_type from, size_type to, Pred pred)
+  {
+    // la ricerca del primo da togliere non scrive nel buffer
+    size_type write = from;
+    while (write < to && !pred(_array[write]))
+      ++write;
+    if (write >= to)
+      return 0;
+
+    detach();
+#ifdef SORTEDARRAY_STATS
+    size_type first = write;
+#endif
+    size_type read = write + 1;
+    try
+    {
+      for (; read < _size; ++read)
+      {
+        if (read >= to || !pred(_array[read]))
+          _array[write++] = std::move(_array[read]);
+      }
+    }
+    catch (...)
+    {
+      for (; read < _size; ++read)
+        _array[write++] = std::move(_array[read]);
+      shrink_to(write);
+      throw;
+    }
+    SORTEDARRAY_STAT(_stats.bytes_moved +=
+                     static_cast<unsigned long long>(write - first) * sizeof(value_type));
+    size_type removed = _size - write;
+    shrink_to(write);
+    return removed;
+  }
+
+  void shrink_to(size_type size)
+  {
+    _filter_stale += _size - size;
+    _size = size;
+    if (_size == 0)
+      release();
+    invalidate();
+    refresh_filter();
+  }
+
+  // rilascia il riferimento al buffer, liberandolo se era l'ultimo
+  void release()
+  {
+    if (_refs != nullptr &&
+        _refs->fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      delete[] _buffer;
+      delete _refs;
+    }
+    _array = nullptr;
+    _buffer = nullptr;
+    _refs = nullptr;
+    _capacity = 0;
+  }
+
+  // sostituisce il buffer con uno appena costruito da questo oggetto,
+  // di capacity elementi; se il vecchio non era condiviso se ne riusa
+  // il contatore
+  void adopt(value_type *new_array, size_type capacity)
+  {
+    if (_refs != nullptr && _refs->load(std::memory_order_acquire) == 1)
+    {
+      delete[] _buffer;
+      _array = _buffer = new_array;
+      _capacity = capacity;
+      return;
+    }
+    std::atomic<unsigned long> *refs = nullptr;
+    try
+    {
+      refs = new std::atomic<unsigned long>(1);
+    }
+    catch (...)
+    {
+      delete[] new_array;
+      throw;
+    }
+    release();
+    _array = _buffer = new_array;
+    _refs = refs;
+    _capacity = capacity;
+  }
+
+  // prima di scrivere nel buffer: se e' condiviso se ne fa una copia privata
+  void detach()
+  {
+    if (_refs == nullptr || _refs->load(std::memory_order_acquire) == 1)
+      return;
+
+    value_type *new_array = new value_type[_size];
+    SORTEDARRAY_STAT(count_copy(_size));
+    try
+    {
+      for (size_type i = 0; i < _size; ++i)
+        new_array[i] = _array[i];
+    }
+    catch (...)
+    {
+      delete[] new_array;
+      throw;
+    }
+    adopt(new_array, _size);
+  }
+
+#ifdef SORTEDARRAY_STATS
+  void count_probe() const
+  {
+    ++_stats.comparisons;
+    ++_stats.probes;
+  }
+
+  void begin_search() const
+  {
+    _probe_mark = _stats.probes;
+  }
+
+  void end_search() const
+  {
+    ++_stats.searches;
+    if (_stats.probes - _probe_mark > _stats.max_probes)
+      _stats.max_probes = _stats.probes - _probe_mark;
+  }
+
+  // allocazione di un nuovo array in cui vengono copiati n elementi
+  void count_copy(size_type n) const
+  {
+    ++_stats.allocations;
+    _stats.bytes_moved += static_cast<unsigned long long>(n) * sizeof(value_type);
+  }
+
+  void count_insert(size_type shift) const
+  {
+    ++_stats.inserts;
+    _stats.insert_shift += shift;
+  }
+#endif
+
+  // scarta le informazioni derivate dal contenuto (da chiamare a ogni
+  // modifica); il filtro invece si aggiorna con refresh_filter()
+  void invalidate()
+  {
+    _sampled.store(false, std::memory_order_relaxed);
+    _learned_ready.store(false, std::memory_order_relaxed);
+    drop_tables();
+  }
+
+  // libera le somme prefisse e le sparse table
+  void drop_tables()
+  {
+    table_node *t = _tables.load(std::memory_order_relaxed);
+    _tables.store(nullptr, std::memory_order_relaxed);
+    while (t != nullptr)
+    {
+      table_node *next = t->next;
+      delete t;
+      t = next;
+    }
+  }
+
+  template <typename U>
+  static void swap_atomic(std::atomic<U> &a, std::atomic<U> &b)
+  {
+    U tmp = a.load(std::memory_order_relaxed);
+    a.store(b.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    b.store(tmp, std::memory_order_relaxed);
+  }
+
+  template <typename H>
+  static std::size_t hash_with(const value_type &item)
+  {
+    return H()(item);
+  }
+
+  // true se il filtro esclude target; il filtro si legge soltanto
+  bool filter_rejects(const value_type &target) const
+  {
+    if (!_filter_ready || _filter->may_contain(_filter_hash(target)))
+      return false;
+    _filter_rejected.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // registra l'esito di una ricerca che ha passato il filtro
+  bool filter_outcome(bool found) const
+  {
+    if (_filter_ready)
+    {
+      _filter_passed.fetch_add(1, std::memory_order_relaxed);
+      if (!found)
+        _filter_false_positives.fetch_add(1, std::memory_order_relaxed);
+    }
+    return found;
+  }
+
+  // costruisce il filtro con spazio per il doppio degli elementi attuali,
+  // cosi' gli insert successivi lo aggiornano senza ricostruirlo subito
+  void build_filter()
+  {
+    _filter_ready = false;
+    size_type keys = (_size < 512) ? 1024 : 2 * _size;
+    BlockedBloomFilter *filter = new BlockedBloomFilter();
+    try
+    {
+      filter->build(keys, _filter_fpr);
+      for (size_type i = 0; i < _size; ++i)
+        filter->add(_filter_hash(_array[i]));
+    }
+    catch (...)
+    {
+      delete filter;
+      throw;
+    }
+    delete _filter;
+    _filter = filter;
+    _filter_keys = keys;
+    _filter_stale = 0;
+    _filter_ready = true;
+  }
+
+  /*
+    Dopo una modifica: ricostruisce il filtro quando le chiavi presenti piu'
+    quelle tolte (i cui bit restano impostati) superano le chiavi previste.
+    Se la ricostruzione fallisce la modifica resta valida: il filtro si
+    spegne (find e count cercano sempre nell'array) e si riprova alla
+    modifica successiva.
+  */
+  void refresh_filter()
+  {
+    if (_filter_hash == nullptr ||
+        (_filter_ready && _size + _filter_stale <= _filter_keys))
+      return;
+    try
+    {
+      build_filter();
+    }
+    catch (...)
+    {
+    }
+  }
+
+  // somma delle posizioni [first, last): somme prefisse se si possono
+  // tenere per la coppia (Acc, Proj), altrimenti un passaggio sull'intervallo
+  template <typename Acc, typename Proj>
+  Acc sum_positions(size_type first, size_type last, Proj &proj) const
+  {
+    if (last <= first)
+      return Acc();
+    if constexpr (std::is_same<Acc, value_type>::value &&
+                  std::is_same<Proj, sortedarray_identity>::value)
+    {
+      typedef typename prefix_of<value_type>::type S;
+      auto term = [this](size_type i)
+      {
+        return static_cast<S>(_array[i]);
+      };
+      const S *prefix = prefix_sums<S>(term);
+      return static_cast<value_type>(prefix[last] - prefix[first]);
+    }
+    else if constexpr (std::is_arithmetic<Acc>::value && std::is_empty<Proj>::value)
+    {
+      typedef typename prefix_of<Acc>::type S;
+      auto term = [this, &proj](size_type i)
+      {
+        return static_cast<S>(static_cast<Acc>(proj(_array[i])));
+      };
+      const S *prefix = prefix_sums<S>(term);
+      return static_cast<Acc>(prefix[last] - prefix[first]);
+    }
+    else
+    {
+      Acc sum = Acc();
+      for (size_type i = first; i < last; ++i)
+        sum = sum + static_cast<Acc>(proj(_array[i]));
+      return sum;
+    }
+  }
+
+  /*
+    Le somme prefisse degli interi si tengono nel tipo senza segno
+    corrispondente (dopo la promozione, per non moltiplicare unsigned
+    short in int): l'aritmetica modulare non ha overflow e la differenza
+    di due prefissi e' esatta quando la somma dell'intervallo sta in U,
+    anche se il totale dell'array non ci sta.
+  */
+  template <typename U>
+  struct prefix_of
+  {
+    typedef typename std::conditional<
+        std::is_integral<U>::value,
+        std::make_unsigned<decltype(std::declval<U>() + std::declval<U>())>,
+        std::enable_if<true, U>>::type::type type;
+  };
+
+  /*
+    Tabelle derivate dal contenuto (somme prefisse, sparse table), una per
+    combinazione di tipi. Il tag e' l'indirizzo di una variabile statica
+    diversa per ogni funzione di costruzione, quindi per ogni Acc e Proj.
+    Formano una lista che si allunga in testa sotto _cache_lock e viene
+    liberata da drop_tables(): i lettori la percorrono senza lock.
+  */
+  struct table_node
+  {
+    const void *tag;
+    table_node *next;
+
+    explicit table_node(const void *t) : tag(t), next(nullptr) {}
+    virtual ~table_node() {}
+  };
+
+  template <typename S>
+  struct table : table_node
+  {
+    S *data;
+
+    table(const void *t, size_type n) : table_node(t), data(new S[n]) {}
+    ~table()
+    {
+      delete[] data;
+    }
+  };
+
+  template <typename Build>
+  static const void *table_tag()
+  {
+    static const char tag = 0;
+    return &tag;
+  }
+
+  // tabella di n valori riempita da build alla prima richiesta e
+  // pubblicata con _tables
+  template <typename S, typename Build>
+  const S *cached_table(size_type n, Build build) const
+  {
+    const void *tag = table_tag<Build>();
+    for (table_node *t = _tables.load(std::memory_order_acquire); t != nullptr; t = t->next)
+      if (t->tag == tag)
+        return static_cast<table<S> *>(t)->data;
+
+    std::lock_guard<std::mutex> lock(_cache_lock);
+    table_node *head = _tables.load(std::memory_order_relaxed);
+    for (table_node *t = head; t != nullptr; t = t->next)
+      if (t->tag == tag)
+        return static_cast<table<S> *>(t)->data;
+
+    table<S> *made = new table<S>(tag, n);
+    SORTEDARRAY_STAT(++_stats.allocations);
+    try
+    {
+      build(made->data);
+    }
+    catch (...)
+    {
+      delete made;
+      throw;
+    }
+    made->next = head;
+    _tables.store(made, std::memory_order_release);
+    return made->data;
+  }
+
+  // somme prefisse: prefix[i] = somma di term(j) per j < i
+  template <typename S, typename Term>
+  const S *prefix_sums(Term term) const
+  {
+    size_type n = _size;
+    auto build = [&term, n](S *prefix)
+    {
+      prefix[0] = S();
+      for (size_type i = 0; i < n; ++i)
+        prefix[i + 1] = prefix[i] + term(i);
+    };
+    return cached_table<S>(n + 1, build);
+  }
+
+  static size_type floor_log2(size_type n)
+  {
+    size_type k = 0;
+    while (n >>= 1)
+      ++k;
+    return k;
+  }
+
+  /*
+    Posizione in [first, last) con proj minimo (Max = false) o massimo,
+    la prima a parita'. Con Proj senza stato usa una sparse table:
+    best[k * n + i] e' la posizione migliore in [i, i + 2^k), e due
+    finestre sovrapposte coprono qualunque intervallo.
+  */
+  template <bool Max, typename Proj>
+  size_type extreme_position(size_type first, size_type last, Proj &proj) const
+  {
+    auto pick = [this, &proj](size_type a, size_type b)
+    {
+      bool b_better = Max ? proj(_array[a]) < proj(_array[b])
+                          : proj(_array[b]) < proj(_array[a]);
+      bool a_better = Max ? proj(_array[b]) < proj(_array[a])
+                          : proj(_array[a]) < proj(_array[b]);
+      return (b_better || (!a_better && b < a)) ? b : a;
+    };
+
+    if constexpr (std::is_empty<Proj>::value)
+    {
+      size_type n = _size;
+      auto build = [&pick, n](size_type *best)
+      {
+        for (size_type i = 0; i < n; ++i)
+          best[i] = i;
+        for (size_type k = 1; (size_type(1) << k) <= n; ++k)
+        {
+          const size_type *prev = best + (k - 1) * n;
+          size_type half = size_type(1) << (k - 1);
+          for (size_type i = 0; i + 2 * half <= n; ++i)
+            best[k * n + i] = pick(prev[i], prev[i + half]);
+        }
+      };
+      const size_type *best = cached_table<size_type>(n * (floor_log2(n) + 1), build);
+      size_type k = floor_log2(last - first);
+      return pick(best[k * n + first], best[k * n + last - (size_type(1) << k)]);
+    }
+    else
+    {
+      size_type found = first;
+      for (size_type i = first + 1; i < last; ++i)
+        found = pick(found, i);
+      return found;
+    }
+  }
+
+  // ricerca usata anche da insert: non ricostruisce l'indice appreso
+  size_type search_index(const value_type &item) const
+  {
+    if (use_interpolation())
+      return interpolation_index(item);
+    return binary_index(item, 0, _size);
+  }
+
+  // ricerca binaria del primo indice in [under, upper) non minore di item
+  template <typename K>
+  size_type binary_index(const K &item, size_type under, size_type upper) const
+  {
+    order_policy ord;
+
+    while (under < upper)
+    {
+      size_type mid = under + (upper - under) / 2;
+
+      SORTEDARRAY_STAT(count_probe());
+      if (ord(_array[mid], item))
+        under = mid + 1;
+      else
+        upper = mid;
+    }
+
+    return under;
+  }
+
+  bool use_interpolation() const
+  {
+    if (!std::is_arithmetic<value_type>::value ||
+        _search_mode == search_binary ||
+        _size < interpolation_cutoff)
+      return false;
+    if (_search_mode == search_interpolation)
+      return true;
+    if (!_sampled.load(std::memory_order_acquire))
+    {
+      std::lock_guard<std::mutex> lock(_cache_lock);
+      if (!_sampled.load(std::memory_order_relaxed))
+      {
+        _interpolate = sample_uniformity();
+        _sampled.store(true, std::memory_order_release);
+      }
+    }
+    return _interpolate;
+  }
+
+  // la modalita' adattiva campiona l'array e confronta la posizione reale
+  // dei campioni con quella prevista dalla retta tra primo e ultimo elemento
+  bool sample_uniformity() const
+  {
+    if constexpr (std::is_arithmetic<value_type>::value)
+    {
+      if (_size < 4 * adaptive_samples)
+        return false;
+      double first = static_cast<double>(_array[0]);
+      double span = static_cast<double>(_array[_size - 1]) - first;
+      if (!(span != 0))
+        return false;
+      double last = static_cast<double>(_size - 1);
+      double max_error = 0;
+      for (size_type k = 1; k < adaptive_samples; ++k)
+      {
+        size_type i = (_size - 1) / adaptive_samples * k;
+        double predicted = (static_cast<double>(_array[i]) - first) / span * last;
+        double error = std::fabs(predicted - static_cast<double>(i));
+        if (!(error <= max_error))
+          max_error = error;
+      }
+      // tollero uno scarto di 1/16 della lunghezza
+      return max_error <= last / 16;
+    }
+    return false;
+  }
+
+  // posizione stimata di item in [under, upper) per interpolazione lineare
+  size_type interpolate(const value_type &item, size_type under, size_type upper) const
+  {
+    if constexpr (std::is_arithmetic<value_type>::value)
+    {
+      double lo = static_cast<double>(_array[under]);
+      double hi = static_cast<double>(_array[upper - 1]);
+      double f = (static_cast<double>(item) - lo) / (hi - lo);
+      if (!(f > 0)) // anche NaN
+        f = 0;
+      if (f > 1)
+        f = 1;
+      return under + static_cast<size_type>(f * (upper - 1 - under));
+    }
+    return under + (upper - under) / 2;
+  }
+
+  /*
+    Ricerca per interpolazione con guardia: ogni passo sonda la posizione
+    interpolata e poi un secondo punto a distanza sqrt(lunghezza) nella
+    direzione del target, cosi' l'intervallo passa da n a sqrt(n).
+    Se un passo non dimezza l'intervallo si fa anche una bisezione, quindi
+    il caso peggiore resta O(log n). Le sonde decidono solo dove confrontare:
+    la correttezza dipende esclusivamente da order_policy.
+  */
+  size_type interpolation_index(const value_type &item) const
+  {
+    order_policy ord;
+    size_type under = 0;
+    size_type upper = _size;
+
+    while (upper - under > interpolation_cutoff)
+    {
+      size_type len = upper - under;
+      size_type gap = static_cast<size_type>(std::sqrt(static_cast<double>(len)));
+      size_type pos = interpolate(item, under, upper);
+
+      SORTEDARRAY_STAT(count_probe());
+      if (ord(_array[pos], item))
+      {
+        under = pos + 1;
+        size_type guard = pos + gap;
+        if (guard < upper)
+        {
+          SORTEDARRAY_STAT(count_probe());
+          if (ord(_array[guard], item))
+            under = guard + 1;
+          else
+            upper = guard;
+        }
+      }
+      else
+      {
+        upper = pos;
+        if (pos >= under + gap)
+        {
+          size_type guard = pos - gap;
+          SORTEDARRAY_STAT(count_probe());
+          if (ord(_array[guard], item))
+            under = guard + 1;
+          else
+            upper = guard;
+        }
+      }
+
+      if (upper - under > len / 2 && under < upper)
+      {
+        size_type mid = under + (upper - under) / 2;
+        SORTEDARRAY_STAT(count_probe());
+        if (ord(_array[mid], item))
+          under = mid + 1;
+        else
+          upper = mid;
+      }
+    }
+
+    return binary_index(item, under, upper);
+  }
+
+  bool use_learned_index() const
+  {
+    if constexpr (std::is_arithmetic<value_type>::value)
+    {
+      if (_learned_epsilon == 0 || _size < interpolation_cutoff)
+        return false;
+      if (!_learned_ready.load(std::memory_order_acquire))
+      {
+        std::lock_guard<std::mutex> lock(_cache_lock);
+        if (!_learned_ready.load(std::memory_order_relaxed))
+        {
+          if (_learned == nullptr)
+            _learned = new LearnedIndex<value_type>();
+          _learned_usable = _learned->build(_array, _size, _learned_epsilon);
+          _learned_ready.store(true, std::memory_order_release);
+        }
+      }
+      return _learned_usable;
+    }
+    return false;
+  }
+
+  /*
+    Ricerca guidata dal modello: si cerca in [pred - eps, pred + eps].
+    Prima si verifica che la risposta cada davvero nella finestra; se il
+    modello sbaglia (chiavi non presenti nel training, errori di
+    arrotondamento) si galoppa verso l'esterno, quindi il risultato dipende
+    solo da order_policy.
+  */
+  size_type learned_index(const value_type &item) const
+  {
+    if constexpr (std::is_arithmetic<value_type>::value)
+    {
+      order_policy ord;
+      size_type pred = _learned->predict(item, _size);
+      size_type eps = _learned->epsilon();
+      size_type under = (pred > eps) ? pred - eps : 0;
+      size_type upper = (_size - pred > eps + 1) ? pred + eps + 1 : _size;
+
+      if (under > 0)
+      {
+        SORTEDARRAY_STAT(count_probe());
+        if (!ord(_array[under - 1], item))
+          return gallop_left(item, under - 1);
+      }
+      if (upper < _size)
+      {
+        SORTEDARRAY_STAT(count_probe());
+        if (ord(_array[upper], item))
+          return gallop_right(item, upper + 1);
+      }
+      return binary_index(item, under, upper);
+    }
+    return binary_index(item, 0, _size);
+  }
+
+  // primo indice non minore di item cercato partendo da pos, in O(log d)
+  // sonde con d distanza tra pos e la risposta
+  size_type gallop_from(const value_type &item, size_type pos) const
+  {
+    order_policy ord;
+    if (pos > _size)
+      pos = _size;
+    if (pos < _size)
+    {
+      SORTEDARRAY_STAT(count_probe());
+      if (ord(_array[pos], item))
+        return gallop_right(item, pos + 1);
+    }
+    return gallop_left(item, pos);
+  }
+
+  // ricerca esponenziale verso sinistra, sapendo che la risposta e' <= upper
+  size_type gallop_left(const value_type &item, size_type upper) const
+  {
+    order_policy ord;
+    size_type step = 1;
+    size_type under = 0;
+    while (upper >= step)
+    {
+      size_type probe = upper - step;
+      SORTEDARRAY_STAT(count_probe());
+      if (ord(_array[probe], item))
+      {
+        under = probe + 1;
+        break;
+      }
+      upper = probe;
+      step *= 2;
+    }
+    return binary_index(item, under, upper);
+  }
+
+  // ricerca esponenziale verso destra, sapendo che la risposta e' >= under
+  size_type gallop_right(const value_type &item, size_type under) const
+  {
+    order_policy ord;
+    size_type step = 1;
+    size_type upper = _size;
+    while (under + step - 1 < _size)
+    {
+      size_type probe = under + step - 1;
+      SORTEDARRAY_STAT(count_probe());
+      if (!ord(_array[probe], item))
+      {
+        upper = probe;
+        break;
+      }
+      under = probe + 1;
+      step *= 2;
+    }
+    return binary_index(item, under, upper);
+  }
+
+  // gli elementi uguali a target possono stare solo tra quelli
+  // equivalenti per order_policy, cioe' da searchsorted(target) in poi
+  template <typename K>
+  size_type get_index_of(const K &target) const
+  {
+    return match_from(target, searchsorted(target));
+  }
+
+  // primo elemento uguale a target a partire da index, npos se non c'e'
+  template <typename K>
+  size_type match_from(const K &target, size_type index) const
+  {
+    equal_policy eq;
+    order_policy ord;
+
+    for (size_type i = index; i < _size; ++i)
+    {
+      SORTEDARRAY_STAT(++_stats.comparisons);
+      if (eq(target, _array[i]))
+      {
+        return i;
+      }
+      SORTEDARRAY_STAT(++_stats.comparisons);
+      if (ord(target, _array[i]))
+      {
+        return npos;
+      }
+    }
+    return npos;
+  }
+
+  // numero di elementi uguali a target da index (primo non minore) in poi
+  template <typename K>
+  size_type count_from(const K &target, size_type index) const
+  {
+    order_policy ord;
+    equal_policy eq;
+    size_type n = 0;
+    for (size_type i = index; i < _size; ++i)
+    {
+      SORTEDARRAY_STAT(++_stats.comparisons);
+      if (ord(target, _array[i]))
+        break;
+      SORTEDARRAY_STAT(++_stats.comparisons);
+      if (eq(target, _array[i]))
+        ++n;
+    }
+    return n;
+  }
+
+private:
+  value_type *_array;
+  size_type _size;
+
+  // contatore dei SortedArray che condividono _array, nullptr se vuoto
+  std::atomic<unsigned long> *_refs = nullptr;
+  value_type *_buffer = nullptr; // inizio del blocco allocato, _array vi punta dentro
+  size_type _capacity = 0;       // elementi allocati in _buffer, >= _size
+  size_type _bound = 0;    // massimo numero di elementi, 0 = illimitato
+
+  /*
+    Campionamento, indice appreso, somme prefisse e sparse table si
+    costruiscono alla prima ricerca che li usa, anche da metodi const
+    chiamati da piu' thread: la costruzione avviene sotto _cache_lock e il
+    flag atomico (o _tables) la pubblica con memory_order_release.
+    invalidate() li azzera senza lock, perche' gira solo dentro le
+    modifiche, che sono esclusive.
+  */
+  mutable std::mutex _cache_lock;
+
+  search_mode _search_mode = search_binary;
+  mutable std::atomic<bool> _sampled{false}; // esito del campionamento valido
+  mutable bool _interpolate = false;         // esito del campionamento
+
+  size_type _learned_epsilon = 0;                     // 0 = indice appreso spento
+  mutable LearnedIndex<value_type> *_learned = nullptr;
+  mutable std::atomic<bool> _learned_ready{false};    // modello aggiornato
+  mutable bool _learned_usable = false;               // esito dell'ultima build
+
+  mutable std::atomic<table_node *> _tables{nullptr}; // somme prefisse e sparse table
+
+  // il filtro si costruisce e si aggiorna solo nelle modifiche
+  double _filter_fpr = 0;                                    // falsi positivi voluti
+  std::size_t (*_filter_hash)(const value_type &) = nullptr; // nullptr = filtro spento
+  BlockedBloomFilter *_filter = nullptr;
+  size_type _filter_keys = 0;                                // chiavi previste dalla build
+  size_type _filter_stale = 0;                               // chiavi tolte dopo la build
+  bool _filter_ready = false;                                // filtro utilizzabile
+  mutable std::atomic<unsigned long long> _filter_rejected{0};
+  mutable std::atomic<unsigned long long> _filter_passed{0};
+  mutable std::atomic<unsigned long long> _filter_false_positives{0};
+
+#ifdef SORTEDARRAY_STATS
+  mutable sortedarray_stats _stats;
+  mutable unsigned long long _probe_mark = 0; // sonde all'inizio della ricerca
+#endif
+};
+
+/**
+  @brief Specializzazione di SortedArray per run_length_policy
+
+  Gli elementi uguali secondo equal_policy sono memorizzati una sola volta,
+  insieme al numero di ripetizioni. I rappresentanti delle run (il primo
+  inserito di ogni gruppo) stanno in un SortedArray con unique_policy,
+  ereditato in modo privato: ricerca, strategie di ricerca, indice
+  appreso, filtro di appartenenza, contatori e crescita geometrica del
+  buffer sono gli stessi della classe generale. Accanto ci sono le
+  ripetizioni di ogni run, con la stessa crescita geometrica, e un albero
+  di Fenwick sulle ripetizioni per passare da posizioni logiche a run.
+
+  Dall'esterno si comporta come il multiset: size(), operator[], gli
+  iteratori, searchsorted e le interrogazioni su intervalli lavorano su
+  posizioni logiche, ma la memoria dipende solo dal numero di valori
+  distinti. Mancano solo data(), perche' gli elementi logici non sono
+  contigui, e set_bound().
+
+  Costi, con r numero di run: aggiungere o togliere una copia di un
+  valore gia' presente O(log r) senza allocare; creare o togliere una run
+  O(r) come nella classe generale (O(log r) ammortizzato in coda);
+  operator[] O(log r).
+*/
+template <typename T, typename P, typename Q>
+class SortedArray<T, P, Q, run_length_policy>
+    : private SortedArray<T, P, Q, unique_policy>
+{
+  // rappresentanti delle run, uno per valore distinto
+  typedef SortedArray<T, P, Q, unique_policy> run_store;
+
+public:
+  typedef T value_type;           /// Tipo del dato dell'array
+  typedef std::size_t size_type;  /// Tipo del dato size, a 64 bit
+  typedef P order_policy;
+  typedef Q equal_policy;
+  typedef run_length_policy duplicate_policy;
+
+  typedef typename run_store::search_mode search_mode;
+  using run_store::search_binary;
+  using run_store::search_interpolation;
+  using run_store::search_adaptive;
+
+  // configurazione della ricerca e contatori, identici alla classe generale
+  using run_store::set_search_mode;
+  using run_store::get_search_mode;
+  using run_store::enable_learned_index;
+  using run_store::disable_learned_index;
+  using run_store::learned_index_bytes;
+  using run_store::enable_filter;
+  using run_store::disable_filter;
+  using run_store::filter_bytes;
+  using run_store::filter_stats;
+  using run_store::stats;
+  using run_store::reset_stats;
+  using run_store::find;
+
+  /**
+    @brief Costruttore di default
+
+    @post size() = 0
+  */
+  SortedArray()
+  {
+  }
+
+  /**
+    @brief Distruttore
+
+    Libera le ripetizioni; i rappresentanti li libera la classe base.
+  */
+  ~SortedArray()
+  {
+    delete[] _counts;
+    delete[] _tree;
+  }
+
+  /**
+    @brief Copy Constructor
+
+    I rappresentanti sono condivisi copy-on-write come nella classe
+    generale, le ripetizioni vengono copiate: O(r).
+
+    @param other SortedArray sorgente da copiare
+
+    @post runs() = other.runs()
+  */
+  SortedArray(const SortedArray &other) : run_store(other), _total(other._total)
+  {
+    if (other.runs() == 0)
+      return;
+
+    try
+    {
+      _counts = new size_type[other.runs()];
+      _tree = new size_type[other.runs() + 1];
+    }
+    catch (...)
+    {
+      delete[] _counts;
+      throw;
+    }
+    _count_capacity = other.runs();
+    for (size_type r = 0; r < other.runs(); ++r)
+      _counts[r] = other._counts[r];
+    for (size_type i = 0; i <= other.runs(); ++i)
+      _tree[i] = other._tree[i];
+  }
+
+  /**
+    @brief Costruttore da iteratori
+
+    @param begin Iter di inizio seq
+    @param end iteratore di fine seq
+
+    @post size() = diff(end, begin)
+  */
+  template <typename Iter>
+  SortedArray(Iter begin, Iter end)
+  {
+    try
+    {
+      for (; begin != end; ++begin)
+        this->insert(static_cast<value_type>(*begin));
+    }
+    catch (...)
+    {
+      makeEmpty();
+      throw;
+    }
+  }
+
+  /**
+    @brief Costruttore da altro generico Sorted Array.
+
+    @param other SortedArray sorgente
+
+    @post size() = other.size()
+  */
+  template <typename U, typename R, typename S, typename E>
+  SortedArray(const SortedArray<U, R, S, E> &other)
+  {
+    try
+    {
+      for (typename SortedArray<U, R, S, E>::size_type i = 0; i < other.size(); ++i)
+        this->insert(static_cast<value_type>(other[i]));
+    }
+    catch (...)
+    {
+      makeEmpty();
+      throw;
+    }
+  }
+
+  /**
+    @brief Operatore di assegnamento
+
+    @param other SortedArray sorgente da copiare
+
+    @return reference all'oggetto corrente
+  */
+  SortedArray &operator=(const SortedArray &other)
+  {
+    if (this != &other)
+    {
+      SortedArray tmp(other);
+      this->swap(tmp);
+    }
+    return *this;
+  }
+
+  /**
+    @brief Inserimento di un elemento
+
+    Se esiste gia' una run uguale secondo equal_policy se ne incrementa il
+    contatore, altrimenti si crea una nuova run in posizione ordinata.
+
+    @param item elemento da inserire
+
+    @return true, l'inserimento non viene mai rifiutato
+
+    @post size()++
+  */
+  bool insert(const value_type &item)
+  {
+    SORTEDARRAY_STAT(this->begin_search());
+    size_type index = this->search_index(item);
+    SORTEDARRAY_STAT(this->end_search());
+    add_at(index, item, 1);
+    return true;
+  }
+
+  /**
+    @brief Rimozione di un elemento
+
+    Rimuove una sola occorrenza; la run sparisce quando arriva a zero.
+
+    @param item elemento da rimuovere
+
+    @return 0 if manages to remove
+    @return -1 if it fails
+  */
+  int remove(const value_type &item)
+  {
+    size_type r = this->get_index_of(item);
+    if (r == npos)
+      return -1;
+    drop(r, 1);
+    return 0;
+  }
+
+  /**
+    @brief Rimozione di un elemento cercato per chiave
+
+    Come @ref remove(const value_type &), con order_policy e equal_policy
+    trasparenti.
+
+    @param key chiave dell'elemento da rimuovere
+
+    @return 0 se rimosso, -1 se non trovato
+  */
+  template <typename K, typename O = order_policy, typename E = equal_policy,
+            typename = typename O::is_transparent, typename = typename E::is_transparent>
+  int remove(const K &key)
+  {
+    size_type r = this->get_index_of(key);
+    if (r == npos)
+      return -1;
+    drop(r, 1);
+    return 0;
+  }
+
+  /**
+    @brief Rimozione degli elementi con chiave in [lo, hi)
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+
+    @return numero di elementi rimossi
+  */
+  size_type erase_range(const value_type &lo, const value_type &hi)
+  {
+    return erase_span(searchsorted(lo), searchsorted(hi));
+  }
+
+  /**
+    @brief Rimozione di tutte le occorrenze di un elemento
+
+    Toglie l'intera run uguale a item, in O(log r) piu' lo spostamento
+    delle run successive.
+
+    @param item elemento da rimuovere
+
+    @return numero di elementi rimossi
+  */
+  size_type erase_all(const value_type &item)
+  {
+    size_type r = this->get_index_of(item);
+    if (r == npos)
+      return 0;
+    size_type n = _counts[r];
+    drop(r, n);
+    return n;
+  }
+
+  /**
+    @brief Rimozione degli elementi che soddisfano un predicato
+
+    pred viene valutato una volta per run; se lancia l'array non cambia.
+
+    @param pred funtore booleano su value_type
+
+    @return numero di elementi rimossi
+  */
+  template <typename Pred>
+  size_type erase_if(Pred pred)
+  {
+    size_type n = runs();
+    if (n == 0)
+      return 0;
+
+    bool *gone = new bool[n];
+    size_type removed = 0;
+    try
+    {
+      for (size_type r = 0; r < n; ++r)
+      {
+        gone[r] = pred(this->_array[r]);
+        if (gone[r])
+          removed += _counts[r];
+      }
+      if (removed != 0)
+        this->compact(0, n, [this, gone](const value_type &x)
+                      { return gone[&x - this->_array]; });
+    }
+    catch (...)
+    {
+      delete[] gone;
+      throw;
+    }
+
+    size_type write = 0;
+    for (size_type r = 0; r < n; ++r)
+      if (!gone[r])
+        _counts[write++] = _counts[r];
+    delete[] gone;
+    build_tree();
+    _total -= removed;
+    return removed;
+  }
+
+  /**
+    @brief Rimozione degli elementi minori di key
+
+    @param key primo valore da tenere
+
+    @return numero di elementi rimossi
+  */
+  size_type trim_below(const value_type &key)
+  {
+    return erase_span(0, searchsorted(key));
+  }
+
+  /**
+    @brief Rimozione degli elementi maggiori di key
+
+    @param key ultimo valore da tenere (anche i suoi equivalenti restano)
+
+    @return numero di elementi rimossi
+  */
+  size_type trim_above(const value_type &key)
+  {
+    return erase_span(start(this->upper_index(key)), _total);
+  }
+
+  /**
+    @brief Searchsorted, ritorna indice logico al quale inserire
+
+    La run si cerca con la strategia impostata (@ref set_search_mode(),
+    @ref enable_learned_index()), poi la posizione logica si legge
+    dall'albero delle ripetizioni in O(log r).
+
+    @param item elemento da cercare
+
+    @return posizione logica del primo elemento non minore di item
+  */
+  size_type searchsorted(const value_type &item) const
+  {
+    return start(run_store::searchsorted(item));
+  }
+
+  /**
+    @brief Searchsorted con una chiave di tipo K
+
+    @param key chiave da cercare
+
+    @return posizione logica del primo elemento non minore di key
+  */
+  template <typename K, typename O = order_policy, typename = typename O::is_transparent>
+  size_type searchsorted(const K &key) const
+  {
+    return start(run_store::searchsorted(key));
+  }
+
+  /**
+    @brief Riserva spazio per almeno n run
+
+    @param n numero di valori distinti da poter contenere
+  */
+  void reserve(size_type n)
+  {
+    run_store::reserve(n);
+    reserve_counts(n);
+  }
+
+  /**
+    @brief Numero di run contenibili senza riallocare
+
+    @return capacita' dei rappresentanti
+  */
+  size_type capacity() const
+  {
+    return run_store::capacity();
+  }
+
+  /**
+    @brief count - numero di occorrenze di un elemento
+
+    @param target elemento da contare
+
+    @return numero di occorrenze, O(log r)
+  */
+  size_type count(const value_type &target) const
+  {
+    if (this->filter_rejects(target))
+      return 0;
+    size_type r = this->get_index_of(target);
+    this->filter_outcome(r != npos);
+    return (r == npos) ? 0 : _counts[r];
+  }
+
+  /**
+    @brief count con una chiave di tipo K
+
+    @param key chiave da contare
+
+    @return numero di elementi uguali a key
+  */
+  template <typename K, typename O = order_policy, typename E = equal_policy,
+            typename = typename O::is_transparent, typename = typename E::is_transparent>
+  size_type count(const K &key) const
+  {
+    size_type r = this->get_index_of(key);
+    return (r == npos) ? 0 : _counts[r];
+  }
+
+/**
+    @brief Conta gli elementi con chiave in [lo, hi)
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+
+    @return numero di elementi nell'intervallo, O(log r)
+  */
+  size_type range_count(const value_type &lo, const value_type &hi) const
+  {
+    size_type first = searchsorted(lo);
+    size_type last = searchsorted(hi);
+    return (last > first) ? last - first : 0;
+  }
+
+/**
+    @brief Somma degli elementi con chiave in [lo, hi)
+
+    Acc e proj come nella classe generale. Ogni run contribuisce con
+    proj(rappresentante) * ripetizioni, calcolato in Acc: oltre a
+    operator+ serve operator* tra Acc e un conteggio convertito in Acc.
+
+    Con Acc aritmetico e proj senza stato usa somme prefisse pesate sulle
+    run, tenute per ogni coppia (Acc, proj) e ricostruite dopo una
+    modifica (anche delle sole ripetizioni): O(log r). Altrimenti scorre
+    le run dell'intervallo, O(log r + run nell'intervallo).
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+    @param proj funtore che dato un elemento restituisce il valore da sommare
+
+    @return somma nell'intervallo
+  */
+  template <typename Acc = value_type, typename Proj = sortedarray_identity>
+  Acc range_sum(const value_type &lo, const value_type &hi, Proj proj = Proj()) const
+  {
+    return run_sum<Acc>(run_store::searchsorted(lo), run_store::searchsorted(hi), proj);
+  }
+
+/**
+    @brief Minimo (secondo order_policy) degli elementi in [lo, hi)
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+
+    @return reference al minimo, O(log r)
+
+    @pre range_count(lo, hi) > 0
+  */
+  const value_type &range_min(const value_type &lo, const value_type &hi) const
+  {
+    size_type first = run_store::searchsorted(lo);
+    assert(first < run_store::searchsorted(hi));
+    return this->_array[first];
+  }
+
+/**
+    @brief Massimo (secondo order_policy) degli elementi in [lo, hi)
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+
+    @return reference al massimo, O(log r)
+
+    @pre range_count(lo, hi) > 0
+  */
+  const value_type &range_max(const value_type &lo, const value_type &hi) const
+  {
+    size_type last = run_store::searchsorted(hi);
+    assert(run_store::searchsorted(lo) < last);
+    return this->_array[last - 1];
+  }
+
+/**
+    @brief Elemento con la proiezione minima o massima in [lo, hi)
+
+    Come nella classe generale, sui rappresentanti delle run: con proj
+    senza stato O(log r), altrimenti O(log r + run nell'intervallo).
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+    @param proj funtore che dato un elemento restituisce il valore da confrontare
+
+    @return reference all'elemento
+
+    @pre range_count(lo, hi) > 0
+  */
+  template <typename Proj>
+  const value_type &range_min(const value_type &lo, const value_type &hi, Proj proj) const
+  {
+    size_type first = run_store::searchsorted(lo);
+    size_type last = run_store::searchsorted(hi);
+    assert(first < last);
+    return this->_array[this->template extreme_position<false>(first, last, proj)];
+  }
+
+  template <typename Proj>
+  const value_type &range_max(const value_type &lo, const value_type &hi, Proj proj) const
+  {
+    size_type first = run_store::searchsorted(lo);
+    size_type last = run_store::searchsorted(hi);
+    assert(first < last);
+    return this->_array[this->template extreme_position<true>(first, last, proj)];
+  }
+
+/**
+    @brief Interrogazioni su intervalli con chiavi di tipo K
+
+    Come le versioni con estremi di tipo T; disponibili solo se
+    order_policy dichiara is_transparent e confronta K con T.
+
+    @param lo estremo inferiore (incluso)
+    @param hi estremo superiore (escluso)
+  */
+  template <typename K, typename O = order_policy, typename = typename O::is_transparent>
+  size_type range_count(const K &lo, const K &hi) const
+  {
+    size_type first = searchsorted(lo);
+    size_type last = searchsorted(hi);
+    return (last > first) ? last - first : 0;
+  }
+
+  template <typename Acc = value_type, typename K, typename Proj = sortedarray_identity,
+            typename O = order_policy, typename = typename O::is_transparent>
+  Acc range_sum(const K &lo, const K &hi, Proj proj = Proj()) const
+  {
+    return run_sum<Acc>(run_store::searchsorted(lo), run_store::searchsorted(hi), proj);
+  }
+
+  template <typename K, typename O = order_policy, typename = typename O::is_transparent>
+  const value_type &range_min(const K &lo, const K &hi) const
+  {
+    size_type first = run_store::searchsorted(lo);
+    assert(first < run_store::searchsorted(hi));
+    return this->_array[first];
+  }
 
-    @param index della cella da leggere
+  template <typename K, typename O = order_policy, typename = typename O::is_transparent>
+  const value_type &range_max(const K &lo, const K &hi) const
+  {
+    size_type last = run_store::searchsorted(hi);
+    assert(run_store::searchsorted(lo) < last);
+    return this->_array[last - 1];
+  }
 
-    @return reference alla cella index-esima
+  template <typename K, typename Proj, typename O = order_policy, typename = typename O::is_transparent>
+  const value_type &range_min(const K &lo, const K &hi, Proj proj) const
+  {
+    size_type first = run_store::searchsorted(lo);
+    size_type last = run_store::searchsorted(hi);
+    assert(first < last);
+    return this->_array[this->template extreme_position<false>(first, last, proj)];
+  }
+
+  template <typename K, typename Proj, typename O = order_policy, typename = typename O::is_transparent>
+  const value_type &range_max(const K &lo, const K &hi, Proj proj) const
+  {
+    size_type first = run_store::searchsorted(lo);
+    size_type last = run_store::searchsorted(hi);
+    assert(first < last);
+    return this->_array[this->template extreme_position<true>(first, last, proj)];
+  }
+
+  /**
+    @brief makeEmpty - svuota
+
+    @post size() = 0
+  */
+  void makeEmpty()
+  {
+    run_store::makeEmpty();
+    delete[] _counts;
+    delete[] _tree;
+    _counts = nullptr;
+    _tree = nullptr;
+    _count_capacity = 0;
+    _total = 0;
+  }
+
+  /**
+    @brief Filter - filtra l'array e restituisce un altro SortedArray
+
+    Il filtro viene valutato una volta per run; le run scelte si
+    aggiungono in coda, O(1) ammortizzato ciascuna.
+
+    @param filt funtore booleano su value_type
+
+    @return SortedArray con soli gli elementi che soddisfano il filtro
+  */
+  template <typename Policy>
+  SortedArray filter(Policy filt) const
+  {
+    SortedArray result;
+    for (size_type r = 0; r < runs(); ++r)
+      if (filt(this->_array[r]))
+        result.add_at(result.runs(), this->_array[r], _counts[r]);
+    SORTEDARRAY_STAT(this->_stats.filter_tested += runs());
+    SORTEDARRAY_STAT(this->_stats.filter_selected += result.runs());
+    return result;
+  }
+
+  /**
+    @brief Numero di elementi, contando le ripetizioni
+
+    @return dimensione logica
+  */
+  size_type size(void) const
+  {
+    return _total;
+  }
+
+  /**
+    @brief Numero di valori distinti memorizzati
+
+    @return numero di run
+  */
+  size_type runs(void) const
+  {
+    return run_store::size();
+  }
+
+  /**
+    @brief Getter della cella index-esima
+
+    @param index posizione logica della cella
+
+    @return reference al rappresentante della run che contiene index
 
     @pre index < size()
   */
   const value_type &operator[](size_type index) const
   {
-    assert(index < _size);
-    
-    return _array[index];
+    assert(index < _total);
+    return this->_array[run_of(index)];
   }
 
   /**
     @brief Metodo swap per la classe SortedArray
 
-    Funzione che scambia il contenuto di due SortedArray
-
     @param other il SortedArray con cui scambiare il contenuto
   */
   void swap(SortedArray &other)
   {
-    std::swap(_array, other._array);
-    std::swap(_size, other._size);
+    run_store::swap(other);
+    std::swap(_counts, other._counts);
+    std::swap(_tree, other._tree);
+    std::swap(_count_capacity, other._count_capacity);
+    std::swap(_total, other._total);
   }
 
-/**
-    @brief Classe che rappresenta un iteratore di tipo random_access_iterator
+  /**
+    @brief Iteratore random access sulle posizioni logiche
 
-    sfrutta la struttura della classe SortedArray per implementare un puntatore random access
-    
-    @ref SortedArray::begin()
-    @ref SortedArray::end()
+    Ogni run viene restituita tante volte quante sono le sue ripetizioni.
+    L'iteratore e' costante: modificare un rappresentante cambierebbe
+    tutte le sue copie.
   */
-    class iterator
+  class const_iterator
   {
-    //
   public:
     typedef std::random_access_iterator_tag iterator_category;
     typedef T value_type;
     typedef ptrdiff_t difference_type;
-    typedef T *pointer;
-    typedef T &reference;
-
-    iterator()
-    {
-      ptr = nullptr;
-    }
-
-    iterator(const iterator &other)
-    {
-      ptr = other.ptr;
-    }
+    typedef const T *pointer;
+    typedef const T &reference;
 
-    iterator &operator=(const iterator &other)
+    const_iterator() : _owner(nullptr), _index(0), _run(0), _end(0)
     {
-      ptr = other.ptr;
-      return *this;
     }
 
-    ~iterator() {}
-
     // Ritorna il dato riferito dall'iteratore (dereferenziamento)
     reference operator*() const
     {
-      return *ptr;
+      return _owner->_array[_run];
     }
 
     // Ritorna il puntatore al dato riferito dall'iteratore
     pointer operator->() const
     {
-      return ptr;
+      return &_owner->_array[_run];
     }
 
     // Operatore di accesso random
-    reference operator[](int index)
+    reference operator[](difference_type index) const
     {
-      return ptr + index;
+      return (*_owner)[_index + index];
     }
 
     // Operatore di iterazione post-incremento
-    iterator operator++(int)
+    const_iterator operator++(int)
     {
-      iterator old(*this);
-      ++ptr;
+      const_iterator old(*this);
+      ++(*this);
       return old;
     }
 
     // Operatore di iterazione pre-incremento
-    iterator &operator++()
+    const_iterator &operator++()
     {
-      ++ptr;
+      ++_index;
+      if (_index == _end && _run < _owner->runs())
+      {
+        ++_run;
+        if (_run < _owner->runs())
+          _end += _owner->_counts[_run];
+      }
       return *this;
     }
 
     // Operatore di iterazione post-decremento
-    iterator operator--(int)
+    const_iterator operator--(int)
     {
-      iterator old(*this);
-      --ptr;
+      const_iterator old(*this);
+      --(*this);
       return old;
     }
 
     // Operatore di iterazione pre-decremento
-    iterator &operator--()
+    const_iterator &operator--()
     {
-      --ptr;
+      --_index;
+      if (_run == _owner->runs() || _index < _end - _owner->_counts[_run])
+      {
+        if (_run < _owner->runs())
+          _end -= _owner->_counts[_run];
+        --_run;
+      }
       return *this;
     }
 
     // Spostamentio in avanti della posizione
-    iterator operator+(int offset)
+    const_iterator operator+(difference_type offset) const
+    {
+      return const_iterator(_owner, _index + offset);
+    }
+
+    // Spostamentio in avanti della posizione (offset + iteratore)
+    friend const_iterator operator+(difference_type offset, const const_iterator &it)
     {
-      return iterator(ptr + offset);
+      return it + offset;
     }
 
     // Spostamentio all'indietro della posizione
-    iterator operator-(int offset)
+    const_iterator operator-(difference_type offset) const
     {
-      return iterator(ptr - offset);
+      return const_iterator(_owner, _index - offset);
     }
 
     // Spostamentio in avanti della posizione
-    iterator &operator+=(int offset)
+    const_iterator &operator+=(difference_type offset)
     {
-      ptr += offset;
+      *this = *this + offset;
       return *this;
     }
 
     // Spostamentio all'indietro della posizione
-    iterator &operator-=(int offset)
+    const_iterator &operator-=(difference_type offset)
     {
-      ptr -= offset;
+      *this = *this - offset;
       return *this;
     }
 
     // Numero di elementi tra due iteratori
-    difference_type operator-(const iterator &other)
+    difference_type operator-(const const_iterator &other) const
     {
-      return ptr - other.ptr;
+      return static_cast<difference_type>(_index) - static_cast<difference_type>(other._index);
     }
 
     // Uguaglianza
-    bool operator==(const iterator &other) const
+    bool operator==(const const_iterator &other) const
     {
-      return ptr == other.ptr;
+      return _index == other._index;
     }
 
     // Diversita'
-    bool operator!=(const iterator &other) const
+    bool operator!=(const const_iterator &other) const
     {
-      return ptr != other.ptr;
+      return _index != other._index;
     }
 
     // Confronto
-    bool operator>(const iterator &other) const
+    bool operator>(const const_iterator &other) const
     {
-      return ptr > other.ptr;
+      return _index > other._index;
     }
 
-    bool operator>=(const iterator &other) const
+    bool operator>=(const const_iterator &other) const
     {
-      return ptr >= other.ptr;
+      return _index >= other._index;
     }
 
     // Confronto
-    bool operator<(const iterator &other) const
+    bool operator<(const const_iterator &other) const
     {
-      return ptr < other.ptr;
+      return _index < other._index;
     }
 
     // Confronto
-    bool operator<=(const iterator &other) const
+    bool operator<=(const const_iterator &other) const
     {
-      return ptr <= other.ptr;
+      return _index <= other._index;
     }
 
   private:
-
-    T *ptr;
+    const SortedArray *_owner;
+    size_type _index; // posizione logica
+    size_type _run;   // run che contiene _index (runs() per end())
+    size_type _end;   // posizione logica dopo l'ultima copia di _run
     friend class SortedArray;
-    
-    iterator(T *p)
+
+    const_iterator(const SortedArray *owner, size_type index)
+        : _owner(owner), _index(index), _run(owner->run_of(index)),
+          _end(owner->start(_run) + ((_run < owner->runs()) ? owner->_counts[_run] : 0))
     {
-      ptr = p;
     }
+  }; // classe const_iterator
 
-  }; // classe iterator
-/**
+  /// Anche iterator e' costante, come in std::set
+  typedef const_iterator iterator;
+  typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+  typedef const_reverse_iterator reverse_iterator;
+
+  /**
     @brief Iteratore inizio sequenza
-    
-    @return iteratore 
-    @ref iterator
+
+    @return iteratore
   */
-  iterator begin()
+  const_iterator begin() const
   {
-    return iterator(_array);
+    return const_iterator(this, 0);
   }
 
-/**
+  /**
     @brief Iteratore fine sequenza
-    
-    nota: non dereferenzializzarlo : non punta a nessun valore appartenente all'array
-    
-    @return iteratore 
-    @ref iterator
+
+    @return iteratore
+  */
+  const_iterator end() const
+  {
+    return const_iterator(this, _total);
+  }
+
+  const_iterator cbegin() const
+  {
+    return begin();
+  }
+
+  const_iterator cend() const
+  {
+    return end();
+  }
+
+  const_reverse_iterator rbegin() const
+  {
+    return const_reverse_iterator(end());
+  }
+
+  const_reverse_iterator rend() const
+  {
+    return const_reverse_iterator(begin());
+  }
+
+  const_reverse_iterator crbegin() const
+  {
+    return rbegin();
+  }
+
+  const_reverse_iterator crend() const
+  {
+    return rend();
+  }
+
+ /**
+    @brief Rimozione di un intervallo di posizioni logiche
+
+    @param first iteratore al primo elemento da rimuovere
+    @param last iteratore successivo all'ultimo elemento da rimuovere
+
+    @return iteratore all'elemento che seguiva l'ultimo rimosso
+  */
+  iterator erase(const_iterator first, const_iterator last)
+  {
+    size_type from = first._index;
+    erase_span(from, last._index);
+    return const_iterator(this, from);
+  }
+
+ /**
+    @brief Rimozione di un elemento tramite iteratore
+
+    @param pos iteratore all'elemento da rimuovere
+
+    @return iteratore all'elemento successivo
+  */
+  iterator erase(const_iterator pos)
+  {
+    return erase(pos, pos + 1);
+  }
+
+ /**
+    @brief Inserimento di un elemento vicino a una posizione nota
+
+    La run si cerca con una ricerca esponenziale che parte dalla run di
+    hint, come nella classe generale.
+
+    @param hint iteratore vicino alla posizione di inserimento
+    @param item elemento da inserire
+
+    @return iteratore all'ultima copia della run di item
+  */
+  iterator insert(const_iterator hint, const value_type &item)
+  {
+    SORTEDARRAY_STAT(this->begin_search());
+    size_type index = this->gallop_from(item, hint._run);
+    SORTEDARRAY_STAT(this->end_search());
+    size_type r = add_at(index, item, 1);
+    return const_iterator(this, start(r) + _counts[r] - 1);
+  }
+
+ /**
+    @brief Primo elemento non minore di key, cercato a partire da hint
+
+    @param hint iteratore vicino al risultato atteso
+    @param key chiave da cercare
+
+    @return iteratore al primo elemento non minore di key, end() se nessuno
   */
-  iterator end()
+  const_iterator lower_bound(const_iterator hint, const value_type &key) const
   {
-    return iterator(_array + _size);
+    SORTEDARRAY_STAT(this->begin_search());
+    size_type index = this->gallop_from(key, hint._run);
+    SORTEDARRAY_STAT(this->end_search());
+    return const_iterator(this, start(index));
   }
 
+/**
+    @brief Cursore per accessi localizzati
+
+    Come il cursore della classe generale, ma ricorda una run: seek e
+    insert cercano a partire da li' in O(log d) sonde, con d numero di
+    run percorse.
+  */
+  class cursor
+  {
+  public:
+    explicit cursor(SortedArray &owner) : _owner(&owner), _run(0)
+    {
+    }
+
+    /**
+      @brief Sposta il cursore sul primo elemento non minore di key
+
+      @param key chiave da cercare
+
+      @return nuova posizione logica, come searchsorted(key)
+    */
+    size_type seek(const value_type &key)
+    {
+      SORTEDARRAY_STAT(_owner->begin_search());
+      _run = _owner->gallop_from(key, _run);
+      SORTEDARRAY_STAT(_owner->end_search());
+      return _owner->start(_run);
+    }
+
+    /**
+      @brief Inserisce item cercando la run a partire dal cursore
+
+      @param item elemento da inserire
+
+      @return true, l'inserimento non viene mai rifiutato
+    */
+    bool insert(const value_type &item)
+    {
+      SORTEDARRAY_STAT(_owner->begin_search());
+      size_type index = _owner->gallop_from(item, _run);
+      SORTEDARRAY_STAT(_owner->end_search());
+      _run = _owner->add_at(index, item, 1) + 1;
+      return true;
+    }
+
+    /// Posizione logica corrente del cursore
+    size_type position() const
+    {
+      return _owner->start(_run < _owner->runs() ? _run : _owner->runs());
+    }
+
+  private:
+    SortedArray *_owner;
+    size_type _run;
+  };
+
 private:
+  using run_store::npos;
 
-  int get_index_of(const value_type &target) const
+  static size_type lowbit(size_type i)
   {
-    equal_policy eq;
-    order_policy ord;
+    return i & (0 - i);
+  }
+
+  // posizione logica del primo elemento della run r, O(log r)
+  size_type start(size_type r) const
+  {
+    size_type sum = 0;
+    for (; r > 0; r -= lowbit(r))
+      sum += _tree[r];
+    return sum;
+  }
 
-    for (int i = 0; i < _size; ++i)
+  // run che contiene la posizione logica index (runs() se index >= size())
+  size_type run_of(size_type index) const
+  {
+    size_type n = runs();
+    size_type step = 1;
+    while (step * 2 <= n)
+      step *= 2;
+    size_type r = 0;
+    for (; n != 0 && step != 0; step /= 2)
     {
-      if (eq(target, _array[i]))
+      if (r + step <= n && _tree[r + step] <= index)
       {
-        return i;
+        r += step;
+        index -= _tree[r];
       }
-      else if (ord(target, _array[i]))
+    }
+    return r;
+  }
+
+  // aggiunge delta (modulo 2^64, quindi anche negativo) alla run r; le
+  // somme prefisse pesate non sono piu' valide
+  void tree_add(size_type r, size_type delta)
+  {
+    this->drop_tables();
+    for (size_type i = r + 1; i <= runs(); i += lowbit(i))
+      _tree[i] += delta;
+  }
+
+  // ricostruisce l'albero dalle ripetizioni, O(r)
+  void build_tree()
+  {
+    this->drop_tables();
+    size_type n = runs();
+    for (size_type i = 1; i <= n; ++i)
+      _tree[i] = _counts[i - 1];
+    for (size_type i = 1; i <= n; ++i)
+    {
+      size_type parent = i + lowbit(i);
+      if (parent <= n)
+        _tree[parent] += _tree[i];
+    }
+  }
+
+  // porta la capacita' delle ripetizioni ad almeno n run
+  void reserve_counts(size_type n)
+  {
+    if (n <= _count_capacity)
+      return;
+    size_type *counts = new size_type[n];
+    size_type *tree = nullptr;
+    try
+    {
+      tree = new size_type[n + 1];
+    }
+    catch (...)
+    {
+      delete[] counts;
+      throw;
+    }
+    for (size_type r = 0; r < runs(); ++r)
+      counts[r] = _counts[r];
+    for (size_type i = 0; i <= runs(); ++i)
+      tree[i] = (_tree != nullptr) ? _tree[i] : 0;
+    delete[] _counts;
+    delete[] _tree;
+    _counts = counts;
+    _tree = tree;
+    _count_capacity = n;
+  }
+
+  /*
+    Aggiunge n copie di item, con index risultato della ricerca della run
+    (primo rappresentante non minore di item); restituisce la run.
+    Una run nuova in coda aggiorna l'albero in O(log r), altrove lo
+    ricostruisce in O(r), come lo spostamento dei rappresentanti.
+  */
+  size_type add_at(size_type index, const value_type &item, size_type n)
+  {
+    size_type r = this->match_from(item, index);
+    if (r != npos)
+    {
+      _counts[r] += n;
+      tree_add(r, n);
+      _total += n;
+      return r;
+    }
+
+    size_type old_runs = runs();
+    if (old_runs == _count_capacity)
+      reserve_counts((old_runs < 4) ? 4 : 2 * old_runs);
+    this->place(index, item);
+
+    for (size_type k = old_runs; k > index; --k)
+      _counts[k] = _counts[k - 1];
+    _counts[index] = n;
+    if (index == old_runs)
+    {
+      // nodo nuovo in coda: copre le run (index + 1 - lowbit, index]
+      size_type i = index + 1;
+      _tree[i] = n + start(index) - start(i - lowbit(i));
+    }
+    else
+      build_tree();
+    _total += n;
+    return index;
+  }
+
+  // toglie n copie dalla run r, e la run stessa se restano a zero
+  void drop(size_type r, size_type n)
+  {
+    if (_counts[r] > n)
+    {
+      _counts[r] -= n;
+      tree_add(r, 0 - n);
+      _total -= n;
+      return;
+    }
+    remove_runs(r, r + 1, r, 0, 0, 0);
+    _total -= n;
+  }
+
+  /*
+    Toglie le run [from, to), poi imposta a head le copie della run
+    head_run e a tail quelle della run tail_run (0 = non toccare).
+    I rappresentanti si tolgono per primi: se lanciano le ripetizioni
+    restano coerenti con loro.
+  */
+  void remove_runs(size_type from, size_type to, size_type head_run, size_type head,
+                   size_type tail_run, size_type tail)
+  {
+    size_type old_runs = runs();
+    this->erase_positions(from, to);
+    if (head != 0)
+      _counts[head_run] = head;
+    if (tail != 0)
+      _counts[tail_run] = tail;
+    for (size_type k = to; k < old_runs; ++k)
+      _counts[k - (to - from)] = _counts[k];
+    build_tree();
+  }
+
+  // toglie le posizioni logiche [from, to)
+  size_type erase_span(size_type from, size_type to)
+  {
+    if (from >= to)
+      return 0;
+    size_type first = run_of(from);
+    size_type last = run_of(to - 1);
+    size_type head = from - start(first);               // copie tenute di first
+    size_type tail = start(last) + _counts[last] - to;  // copie tenute di last
+
+    if (first == last && head + tail != 0)
+    {
+      _counts[first] -= to - from;
+      tree_add(first, 0 - (to - from));
+    }
+    else
+    {
+      size_type a = (head != 0) ? first + 1 : first;
+      size_type b = (tail != 0) ? last : last + 1;
+      remove_runs(a, b, first, head, last, tail);
+    }
+    _total -= to - from;
+    return to - from;
+  }
+
+  // somma pesata dei rappresentanti delle run [first, last), con somme
+  // prefisse se Acc e' aritmetico e Proj senza stato
+  template <typename Acc, typename Proj>
+  Acc run_sum(size_type first, size_type last, Proj &proj) const
+  {
+    if (last <= first)
+      return Acc();
+    if constexpr (std::is_arithmetic<Acc>::value && std::is_empty<Proj>::value)
+    {
+      typedef typename run_store::template prefix_of<Acc>::type S;
+      auto term = [this, &proj](size_type r)
       {
-        std::cout << "cutting prematurely" << std::endl;
-        return -1;
-      }
+        return static_cast<S>(static_cast<Acc>(proj(this->_array[r]))) * static_cast<S>(_counts[r]);
+      };
+      const S *prefix = this->template prefix_sums<S>(term);
+      return static_cast<Acc>(prefix[last] - prefix[first]);
+    }
+    else
+    {
+      Acc sum = Acc();
+      for (size_type r = first; r < last; ++r)
+        sum = sum + static_cast<Acc>(proj(this->_array[r])) * static_cast<Acc>(_counts[r]);
+      return sum;
     }
-    return -1;
   }
 
-private:
-  value_type *_array;
-  size_type _size;
+  size_type *_counts = nullptr;  // ripetizioni di ogni run
+  size_type *_tree = nullptr;    // albero di Fenwick su _counts, indici da 1
+  size_type _count_capacity = 0; // run contenibili in _counts e _tree
+  size_type _total = 0;          // elementi logici, somma di _counts
 };
 
 /**
@@ -722,11 +3944,11 @@ private:
     
     @ref SortedArray::size
   */
-template <typename T, typename P, typename Q>
-std::ostream &operator<<(std::ostream &os, const SortedArray<T, P, Q> array)
+template <typename T, typename P, typename Q, typename D>
+std::ostream &operator<<(std::ostream &os, const SortedArray<T, P, Q, D> &array)
 {
   os << "array of dim:" << array.size() << '\t' << "| ";
-  for (int i = 0; i < array.size(); i++)
+  for (typename SortedArray<T, P, Q, D>::size_type i = 0; i < array.size(); i++)
   {
     os << array[i] << ' ';
   }